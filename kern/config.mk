@@ -61,6 +61,11 @@ ifdef MATOP_TEST_N_PAGES
 KERN_DEBUG_FLAGS += -DMATOP_TEST_N_PAGES=$(MATOP_TEST_N_PAGES)
 endif
 
+# The largest number of pages mapped by a single page fault
+ifdef FAULT_AROUND_PAGES
+KERN_DEBUG_FLAGS += -DFAULT_AROUND_PAGES=$(FAULT_AROUND_PAGES)
+endif
+
 # If set, enable printing debug messages
 ifneq "$(strip $(DEBUG_MSG) $(DEBUG_ALL))" ""
 KERN_DEBUG_FLAGS	+= -DDEBUG_MSG
@@ -1,8 +1,8 @@
 #include <lib/debug.h>
 #include <lib/x86.h>
 #include <lib/gcc.h>
-#include <lib/queue.h>
 #include <lib/types.h>
+#include <lib/string.h>
 
 #include "mboot.h"
 
@@ -12,40 +12,48 @@ struct pmmap {
     uintptr_t start;
     uintptr_t end;
     uint32_t type;
-    SLIST_ENTRY(pmmap) next;
-    SLIST_ENTRY(pmmap) type_next;
 };
 
-static struct pmmap pmmap_slots[128];
-static int pmmap_slots_next_free = 0;
+#define PMMAP_NSLOTS 128
 
-static SLIST_HEAD(, pmmap) pmmap_list;  /* all memory regions */
-static SLIST_HEAD(, pmmap) pmmap_sublist[4];
-
-enum __pmmap_type { PMMAP_USABLE, PMMAP_RESV, PMMAP_ACPI, PMMAP_NVS };
+/*
+ * All memory regions, sorted by their start addresses.
+ * Entries are indexed directly, so each query is O(1), and the region
+ * containing an address is found with a binary search.
+ */
+static struct pmmap pmmap[PMMAP_NSLOTS];
+static int pmmap_nentries = 0;
 
-#define PMMAP_SUBLIST_NR(type)               \
-    (((type) == MEM_RAM) ? PMMAP_USABLE :    \
-     ((type) == MEM_RESERVED) ? PMMAP_RESV : \
-     ((type) == MEM_ACPI) ? PMMAP_ACPI :     \
-     ((type) == MEM_NVS) ? PMMAP_NVS : -1)
+/* whether some regions (of different types) still overlap after merging */
+static bool pmmap_overlapped = FALSE;
 
 static uintptr_t max_usable_memory = 0;
 static int mem_npages = 0;
-static int pmmap_nentries = 0;
 
-struct pmmap *pmmap_alloc_slot(void)
+/*
+ * Returns the number of entries whose start address is <= addr,
+ * i.e., the position right after the last such entry.
+ */
+static int pmmap_upper_bound(uintptr_t addr)
 {
-    if (unlikely(pmmap_slots_next_free == 128))
-        return NULL;
-    return &pmmap_slots[pmmap_slots_next_free++];
+    int lo = 0, hi = pmmap_nentries, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (pmmap[mid].start <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
 }
 
 /*
  * Insert an physical memory map entry in pmmap[].
  *
  * XXX: The start fields of all entries of the physical memory map are in
- *      incremental order.
+ *      incremental order. An entry is inserted after all the entries with
+ *      the same start address.
  * XXX: The memory regions of some entries maybe overlapped.
  *
  * @param start
@@ -54,72 +62,63 @@ struct pmmap *pmmap_alloc_slot(void)
  */
 static void pmmap_insert(uintptr_t start, uintptr_t end, uint32_t type)
 {
-    struct pmmap *free_slot, *slot, *last_slot;
+    int pos;
 
-    if ((free_slot = pmmap_alloc_slot()) == NULL)
+    if (unlikely(pmmap_nentries == PMMAP_NSLOTS))
         KERN_PANIC("More than 128 E820 entries.\n");
 
-    free_slot->start = start;
-    free_slot->end = end;
-    free_slot->type = type;
-
-    last_slot = NULL;
-
-    SLIST_FOREACH(slot, &pmmap_list, next) {
-        if (start < slot->start)
-            break;
-        last_slot = slot;
-    }
+    pos = pmmap_upper_bound(start);
+    memmove(&pmmap[pos + 1], &pmmap[pos],
+            sizeof(struct pmmap) * (pmmap_nentries - pos));
 
-    if (last_slot == NULL) {
-        SLIST_INSERT_HEAD(&pmmap_list, free_slot, next);
-    } else {
-        SLIST_INSERT_AFTER(last_slot, free_slot, next);
-    }
+    pmmap[pos].start = start;
+    pmmap[pos].end = end;
+    pmmap[pos].type = type;
+    pmmap_nentries++;
 }
 
+/*
+ * Merge overlapped entries of the same type, compacting pmmap[] in place.
+ */
 static void pmmap_merge(void)
 {
-    struct pmmap *slot, *next_slot;
-    struct pmmap *last_slot[4] = { NULL, NULL, NULL, NULL };
-    int sublist_nr;
-
-    /*
-     * Step 1: Merge overlapped entries in pmmap_list.
-     */
-    SLIST_FOREACH(slot, &pmmap_list, next) {
-        if ((next_slot = SLIST_NEXT(slot, next)) == NULL)
-            break;
-        if (slot->start <= next_slot->start &&
-            slot->end >= next_slot->start &&
-            slot->type == next_slot->type) {
-            slot->end = max(slot->end, next_slot->end);
-            SLIST_REMOVE_AFTER(slot, next);
+    int i, last;
+
+    last = -1;
+    for (i = 0; i < pmmap_nentries; i++) {
+        KERN_ASSERT(pmmap[i].type == MEM_RAM || pmmap[i].type == MEM_RESERVED ||
+                    pmmap[i].type == MEM_ACPI || pmmap[i].type == MEM_NVS);
+        if (last >= 0 &&
+            pmmap[last].end >= pmmap[i].start &&
+            pmmap[last].type == pmmap[i].type) {
+            pmmap[last].end = max(pmmap[last].end, pmmap[i].end);
+        } else {
+            pmmap[++last] = pmmap[i];
         }
     }
+    pmmap_nentries = last + 1;
 
-    /*
-     * Step 2: Create the specific lists: pmmap_usable, pmmap_resv,
-     *         pmmap_acpi, pmmap_nvs.
-     */
-    SLIST_FOREACH(slot, &pmmap_list, next) {
-        sublist_nr = PMMAP_SUBLIST_NR(slot->type);
-        KERN_ASSERT(sublist_nr != -1);
-        if (last_slot[sublist_nr] != NULL)
-            SLIST_INSERT_AFTER(last_slot[sublist_nr], slot, type_next);
-        else
-            SLIST_INSERT_HEAD(&pmmap_sublist[sublist_nr], slot, type_next);
-        last_slot[sublist_nr] = slot;
+    pmmap_overlapped = FALSE;
+    for (i = 1; i < pmmap_nentries; i++) {
+        if (pmmap[i].start < pmmap[i - 1].end)
+            pmmap_overlapped = TRUE;
     }
 
-    if (last_slot[PMMAP_USABLE] != NULL)
-        max_usable_memory = last_slot[PMMAP_USABLE]->end;
+    for (i = pmmap_nentries - 1; i >= 0; i--) {
+        if (pmmap[i].type == MEM_RAM) {
+            max_usable_memory = pmmap[i].end;
+            break;
+        }
+    }
 }
 
 static void pmmap_dump(void)
 {
+    int i;
     struct pmmap *slot;
-    SLIST_FOREACH(slot, &pmmap_list, next) {
+
+    for (i = 0; i < pmmap_nentries; i++) {
+        slot = &pmmap[i];
         KERN_INFO("BIOS-e820: 0x%08x - 0x%08x (%s)\n",
                   slot->start,
                   (slot->start == slot->end) ? slot->end :
@@ -138,11 +137,7 @@ void pmmap_init(uintptr_t mbi_addr)
     mboot_info_t *mbi = (mboot_info_t *) mbi_addr;
     mboot_mmap_t *p = (mboot_mmap_t *) mbi->mmap_addr;
 
-    SLIST_INIT(&pmmap_list);
-    SLIST_INIT(&pmmap_sublist[PMMAP_USABLE]);
-    SLIST_INIT(&pmmap_sublist[PMMAP_RESV]);
-    SLIST_INIT(&pmmap_sublist[PMMAP_ACPI]);
-    SLIST_INIT(&pmmap_sublist[PMMAP_NVS]);
+    pmmap_nentries = 0;
 
     /*
      * Copy memory map information from multiboot information mbi to pmmap.
@@ -173,12 +168,6 @@ void pmmap_init(uintptr_t mbi_addr)
     pmmap_merge();
     pmmap_dump();
 
-    /* count the number of pmmap entries */
-    struct pmmap *slot;
-    SLIST_FOREACH(slot, &pmmap_list, next) {
-        pmmap_nentries++;
-    }
-
     /* Calculate the maximum page number */
     mem_npages = rounddown(max_usable_memory, PAGESIZE) / PAGESIZE;
 }
@@ -190,53 +179,48 @@ int get_size(void)
 
 uint32_t get_mms(int idx)
 {
-    int i = 0;
-    struct pmmap *slot = NULL;
-
-    SLIST_FOREACH(slot, &pmmap_list, next) {
-        if (i == idx)
-            break;
-        i++;
-    }
-
-    if (slot == NULL || i == pmmap_nentries)
+    if (idx < 0 || idx >= pmmap_nentries)
         return 0;
 
-    return slot->start;
+    return pmmap[idx].start;
 }
 
 uint32_t get_mml(int idx)
 {
-    int i = 0;
-    struct pmmap *slot = NULL;
+    if (idx < 0 || idx >= pmmap_nentries)
+        return 0;
 
-    SLIST_FOREACH(slot, &pmmap_list, next) {
-        if (i == idx)
-            break;
-        i++;
-    }
+    return pmmap[idx].end - pmmap[idx].start;
+}
 
-    if (slot == NULL || i == pmmap_nentries)
+int is_usable(int idx)
+{
+    if (idx < 0 || idx >= pmmap_nentries)
         return 0;
 
-    return slot->end - slot->start;
+    return pmmap[idx].type == MEM_RAM;
 }
 
-int is_usable(int idx)
+/*
+ * Returns the index of the entry whose region contains addr, or -1 if none.
+ * If several regions of different types overlap at addr, the one with the
+ * greatest start address is returned.
+ *
+ * Only the last entry starting at or below addr can contain it unless some
+ * regions overlap, in which case the earlier entries are checked as well.
+ */
+int pmmap_lookup(uintptr_t addr)
 {
-    int i = 0;
-    struct pmmap *slot = NULL;
+    int idx;
 
-    SLIST_FOREACH(slot, &pmmap_list, next) {
-        if (i == idx)
+    for (idx = pmmap_upper_bound(addr) - 1; idx >= 0; idx--) {
+        if (addr < pmmap[idx].end)
+            return idx;
+        if (!pmmap_overlapped)
             break;
-        i++;
     }
 
-    if (slot == NULL || i == pmmap_nentries)
-        return 0;
-
-    return slot->type == MEM_RAM;
+    return -1;
 }
 
 void set_cr3(unsigned int **pdir)
@@ -249,6 +233,8 @@ void enable_paging(void)
     /* enable global pages (Sec 4.10.2.4, Intel ASDM Vol3) */
     uint32_t cr4 = rcr4();
     cr4 |= CR4_PGE;
+    /* enable 4MB pages for large user mappings (Sec 4.3, Intel ASDM Vol3) */
+    cr4 |= CR4_PSE;
     lcr4(cr4);
 
     /* turn on paging */
@@ -91,6 +91,7 @@ void pmmap_init(uintptr_t mbi_addr);
 int pmmap_entries_nr(void);
 uint32_t pmmap_get_entry_start(int idx);
 uint32_t pmmap_get_entry_length(int idx);
+int pmmap_lookup(uintptr_t addr);
 void set_cr3(unsigned int **pdir);
 void enable_paging(void);
 
@@ -8,12 +8,16 @@
 #define TD_STATE_RUN 1
 
 #ifdef TEST
+extern bool test_MATCache(void);
+extern bool test_MSlab(void);
 extern bool test_MContainer(void);
 extern bool test_MPTIntro(void);
 extern bool test_MPTOp(void);
 extern bool test_MPTComm(void);
 extern bool test_MPTKern(void);
 extern bool test_MPTNew(void);
+extern bool test_MPTReclaim(void);
+extern bool test_MPTShm(void);
 #endif
 
 static void kern_main(void)
@@ -21,6 +25,20 @@ static void kern_main(void)
     KERN_DEBUG("In kernel main.\n\n");
 
 #ifdef TEST
+    dprintf("Testing the MATCache layer...\n");
+    if (test_MATCache() == 0)
+        dprintf("All tests passed.\n");
+    else
+        dprintf("Test failed.\n");
+    dprintf("\n");
+
+    dprintf("Testing the MSlab layer...\n");
+    if (test_MSlab() == 0)
+        dprintf("All tests passed.\n");
+    else
+        dprintf("Test failed.\n");
+    dprintf("\n");
+
     dprintf("Testing the MContainer layer...\n");
     if (test_MContainer() == 0)
         dprintf("All tests passed.\n");
@@ -61,6 +79,20 @@ static void kern_main(void)
         dprintf("All tests passed.\n");
     else
         dprintf("Test failed.\n");
+    dprintf("\n");
+
+    dprintf("Testing the MPTReclaim layer...\n");
+    if (test_MPTReclaim() == 0)
+        dprintf("All tests passed.\n");
+    else
+        dprintf("Test failed.\n");
+    dprintf("\n");
+
+    dprintf("Testing the MPTShm layer...\n");
+    if (test_MPTShm() == 0)
+        dprintf("All tests passed.\n");
+    else
+        dprintf("Test failed.\n");
     dprintf("\nTest complete. Please Use Ctrl-a x to exit qemu.");
 #else
     monitor(NULL);
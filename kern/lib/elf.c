@@ -5,6 +5,7 @@
 #include <lib/x86.h>
 #include <lib/pmap.h>
 #include <lib/gcc.h>
+#include <vmm/MPTKern/export.h>
 #include <vmm/MPTNew/export.h>
 
 #define VM_TOP     0xffffffff
@@ -23,12 +24,27 @@ void *dll[1024] = {
 };
 
 /*
- * Load elf execution file exe to the virtual address space pmap.
+ * Segments of the processes loaded with elf_load_lazy, whose pages are
+ * populated on their first page fault by elf_fault.
  */
-void elf_load(void *exe_ptr, int pid)
+#define ELF_MAX_SEGS 8
+
+struct elf_seg {
+    uint32_t va;      // start of the segment (p_va)
+    uint32_t fva;     // end of the bytes backed by the image (p_va + p_filesz)
+    uint32_t eva;     // end of the segment (p_va + p_memsz)
+    uint32_t offset;  // offset of the segment in the image (p_offset)
+    uint32_t perm;    // page permission
+};
+
+static struct elf_seg elf_segs[NUM_IDS][ELF_MAX_SEGS];
+static int elf_nsegs[NUM_IDS];
+static uintptr_t elf_exe[NUM_IDS];
+
+static proghdr *elf_check(void *exe_ptr, proghdr **eph)
 {
     elfhdr *eh;
-    proghdr *ph, *eph;
+    proghdr *ph;
     sechdr *sh, *esh __attribute__((unused));
     char *strtab __attribute__((unused));
     uintptr_t exe = (uintptr_t) exe_ptr;
@@ -45,45 +61,226 @@ void elf_load(void *exe_ptr, int pid)
     KERN_ASSERT(sh[eh->e_shstrndx].sh_type == ELF_SHT_STRTAB);
 
     ph = (proghdr *) ((uintptr_t) eh + eh->e_phoff);
-    eph = ph + eh->e_phnum;
+    *eph = ph + eh->e_phnum;
+    return ph;
+}
 
-    for (; ph < eph; ph++) {
-        uintptr_t fa;
-        uint32_t va, zva, eva, perm;
+static uint32_t elf_perm(proghdr *ph)
+{
+    uint32_t perm;
+
+    perm = PTE_U | PTE_P;
+    if (ph->p_flags & ELF_PROG_FLAG_WRITE)
+        perm |= PTE_W;
+    return perm;
+}
+
+/*
+ * User programs are embedded in the kernel image, which is identity mapped,
+ * each starting on a page boundary (see misc/build_user_proc_table.py).
+ * A read-only page whose content is a whole page of the image, starting at a
+ * page boundary, can therefore be mapped straight to the frame of the image
+ * that holds it instead of being copied: all the instances of the program
+ * then share that frame, and no page is charged to the process for it.
+ * Returns 1 if the page is mapped this way, 0 otherwise.
+ */
+static int elf_map_image(int pid, uint32_t va, uintptr_t src, uint32_t perm)
+{
+    if ((perm & PTE_W) || src % PAGESIZE != 0)
+        return 0;
+    return map_page(pid, va, src / PAGESIZE, perm) != MagicNumber;
+}
+
+/*
+ * Allocates and fills all the pages of a PT_LOAD segment.
+ */
+static void elf_load_segment(elfhdr *eh, proghdr *ph, int pid)
+{
+    uintptr_t fa;
+    uint32_t va, zva, eva, perm, npages;
+
+    fa = (uintptr_t) eh + rounddown(ph->p_offset, PAGESIZE);
+    va = rounddown(ph->p_va, PAGESIZE);
+    zva = ph->p_va + ph->p_filesz;
+    eva = roundup(ph->p_va + ph->p_memsz, PAGESIZE);
+    perm = elf_perm(ph);
 
+    /* the complete pages of a read-only segment map to the image at once */
+    if (!(perm & PTE_W) && fa % PAGESIZE == 0 && va < rounddown(zva, PAGESIZE)) {
+        npages = (rounddown(zva, PAGESIZE) - va) / PAGESIZE;
+        if (map_range(pid, va, fa / PAGESIZE, npages, perm) != MagicNumber) {
+            va += npages * PAGESIZE;
+            fa += npages * PAGESIZE;
+        }
+    }
+
+    /*
+     * alloc_page hands out zeroed pages, so the bss needs no clearing.
+     * The pages are filled while writable, pt_copyout refusing to write
+     * read-only pages, and get the permission of the segment afterwards.
+     */
+    for (; va < eva; va += PAGESIZE, fa += PAGESIZE) {
+        alloc_page(pid, va, perm | PTE_W);
+
+        if (va < rounddown(zva, PAGESIZE)) {
+            /* copy a complete page */
+            pt_copyout((void *) fa, pid, va, PAGESIZE);
+        } else if (va < zva && ph->p_filesz) {
+            /* copy a partial page */
+            pt_copyout((void *) fa, pid, va, zva - va);
+        }
+
+        if (!(perm & PTE_W))
+            protect_range(pid, va, 1, perm);
+    }
+}
+
+/*
+ * Load elf execution file exe to the virtual address space pmap.
+ */
+void elf_load(void *exe_ptr, int pid)
+{
+    proghdr *ph, *eph;
+
+    ph = elf_check(exe_ptr, &eph);
+
+    for (; ph < eph; ph++) {
         if (ph->p_type != ELF_PROG_LOAD)
             continue;
+        elf_load_segment((elfhdr *) exe_ptr, ph, pid);
+    }
+
+    // set the dynamic linkage page
+    pt_copyout((void *) dll, pid, VM_DYNLINK, sizeof(dll));
+}
+
+/*
+ * Same as elf_load, but the segments are only recorded: each of their pages
+ * is allocated and filled from the image by elf_fault when it is first
+ * touched. Segments beyond ELF_MAX_SEGS are loaded eagerly.
+ */
+void elf_load_lazy(void *exe_ptr, int pid)
+{
+    proghdr *ph, *eph;
+    struct elf_seg *seg;
+
+    ph = elf_check(exe_ptr, &eph);
+
+    elf_exe[pid] = (uintptr_t) exe_ptr;
+    elf_nsegs[pid] = 0;
+
+    for (; ph < eph; ph++) {
+        if (ph->p_type != ELF_PROG_LOAD || ph->p_memsz == 0)
+            continue;
 
-        fa = (uintptr_t) eh + rounddown(ph->p_offset, PAGESIZE);
-        va = rounddown(ph->p_va, PAGESIZE);
-        zva = ph->p_va + ph->p_filesz;
-        eva = roundup(ph->p_va + ph->p_memsz, PAGESIZE);
-
-        perm = PTE_U | PTE_P;
-        if (ph->p_flags & ELF_PROG_FLAG_WRITE)
-            perm |= PTE_W;
-
-        for (; va < eva; va += PAGESIZE, fa += PAGESIZE) {
-            alloc_page(pid, va, perm);
-
-            if (va < rounddown(zva, PAGESIZE)) {
-                /* copy a complete page */
-                pt_copyout((void *) fa, pid, va, PAGESIZE);
-            } else if (va < zva && ph->p_filesz) {
-                /* copy a partial page */
-                pt_memset(pid, va, 0, PAGESIZE);
-                pt_copyout((void *) fa, pid, va, zva - va);
-            } else {
-                /* zero a page */
-                pt_memset(pid, va, 0, PAGESIZE);
-            }
+        if (elf_nsegs[pid] == ELF_MAX_SEGS) {
+            elf_load_segment((elfhdr *) exe_ptr, ph, pid);
+            continue;
         }
+
+        seg = &elf_segs[pid][elf_nsegs[pid]++];
+        seg->va = ph->p_va;
+        seg->fva = ph->p_va + ph->p_filesz;
+        seg->eva = ph->p_va + ph->p_memsz;
+        seg->offset = ph->p_offset;
+        seg->perm = elf_perm(ph);
     }
 
     // set the dynamic linkage page
     pt_copyout((void *) dll, pid, VM_DYNLINK, sizeof(dll));
 }
 
+/*
+ * Forgets the segments recorded by elf_load_lazy for pid, e.g., when its
+ * address space is torn down, so that the id can be reused.
+ */
+void elf_unload(int pid)
+{
+    elf_nsegs[pid] = 0;
+    elf_exe[pid] = 0;
+}
+
+static int elf_seg_covers(struct elf_seg *seg, uint32_t page_va)
+{
+    return rounddown(seg->va, PAGESIZE) <= page_va
+        && page_va < roundup(seg->eva, PAGESIZE);
+}
+
+/*
+ * Returns 1 if the page containing va belongs to a segment recorded by
+ * elf_load_lazy for pid, i.e., it is populated by elf_fault rather than as an
+ * anonymous page, and 0 otherwise.
+ */
+int elf_covers(int pid, uintptr_t va)
+{
+    uint32_t page_va;
+    int i;
+
+    page_va = rounddown(va, PAGESIZE);
+    for (i = 0; i < elf_nsegs[pid]; i++) {
+        if (elf_seg_covers(&elf_segs[pid][i], page_va))
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Populates the page containing va if it belongs to a segment recorded by
+ * elf_load_lazy. The page is zero-filled by alloc_page, and the bytes that
+ * the segments covering it have in the image are copied in; the rest of the
+ * page (bss, or the gaps around the segments) stays zero. A page shared by
+ * two segments gets the bytes and permissions of both.
+ * A read-only page entirely within the image bytes of a single segment is
+ * mapped to the image instead, see elf_map_image.
+ * Returns 1 if the page is populated, 0 if va is not in a recorded segment,
+ * and -1 if there is no memory for the page.
+ */
+int elf_fault(int pid, uintptr_t va)
+{
+    struct elf_seg *seg, *only;
+    uint32_t page_va, perm, start, end;
+    int i, nsegs;
+
+    page_va = rounddown(va, PAGESIZE);
+
+    perm = 0;
+    nsegs = 0;
+    only = NULL;
+    for (i = 0; i < elf_nsegs[pid]; i++) {
+        seg = &elf_segs[pid][i];
+        if (elf_seg_covers(seg, page_va)) {
+            perm |= seg->perm;
+            nsegs++;
+            only = seg;
+        }
+    }
+    if (perm == 0)
+        return 0;
+
+    if (nsegs == 1 && only->va <= page_va && page_va + PAGESIZE <= only->fva
+        && elf_map_image(pid, page_va,
+                         elf_exe[pid] + only->offset + (page_va - only->va),
+                         perm))
+        return 1;
+
+    /* filled while writable, like in elf_load_segment */
+    if (alloc_page(pid, page_va, perm | PTE_W) == MagicNumber)
+        return -1;
+
+    for (i = 0; i < elf_nsegs[pid]; i++) {
+        seg = &elf_segs[pid][i];
+        start = seg->va > page_va ? seg->va : page_va;
+        end = seg->fva < page_va + PAGESIZE ? seg->fva : page_va + PAGESIZE;
+        if (start < end)
+            pt_copyout((void *) (elf_exe[pid] + seg->offset + (start - seg->va)),
+                       pid, start, end - start);
+    }
+    if (!(perm & PTE_W))
+        protect_range(pid, page_va, 1, perm);
+
+    return 1;
+}
+
 uintptr_t elf_entry(void *exe_ptr)
 {
     uintptr_t exe = (uintptr_t) exe_ptr;
@@ -70,6 +70,10 @@ typedef struct sechdr {
 #define ELF_SHN_UNDEF 0
 
 void elf_load(void *exe_ptr, int pid);
+void elf_load_lazy(void *exe_ptr, int pid);
+void elf_unload(int pid);
+int elf_fault(int pid, uintptr_t va);
+int elf_covers(int pid, uintptr_t va);
 uintptr_t elf_entry(void *exe_ptr);
 
 #endif  /* _KERN_ */
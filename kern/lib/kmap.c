@@ -0,0 +1,50 @@
+#include <lib/gcc.h>
+#include <lib/types.h>
+#include <lib/x86.h>
+#include <lib/kmap.h>
+
+#define KMAP_BASE 0xFF800000  // KMAP_PDE * 4MB
+
+// The page table of the kernel window, shared by all the page structures.
+static unsigned int KMAP_TABLE[1024] gcc_aligned(PAGESIZE);
+
+// The number of times a slot was moved to another page.
+static unsigned int KMAP_NREMAPS;
+
+/**
+ * Maps physical page # [page_index] in the slot [slot] of the current CPU,
+ * and returns the address it can be reached at. The mapping lasts until the
+ * slot is used again on this CPU; the TLB entry of the slot is only
+ * invalidated when the slot moves to another page.
+ * Before paging is on, the page is reached directly at its physical address.
+ */
+void *kmap(unsigned int slot, unsigned int page_index)
+{
+    unsigned int idx, va, pte;
+
+    if ((rcr0() & CR0_PG) == 0) {
+        return (void *) (page_index * PAGESIZE);
+    }
+
+    idx = get_pcpu_idx() * KMAP_NSLOTS + slot;
+    va = KMAP_BASE + idx * PAGESIZE;
+    pte = page_index * PAGESIZE | PTE_P | PTE_W | PTE_G;
+    if (KMAP_TABLE[idx] != pte) {
+        KMAP_TABLE[idx] = pte;
+        invlpg(va);
+        KMAP_NREMAPS++;
+    }
+    return (void *) va;
+}
+
+// The physical address of the page table of the kernel window.
+unsigned int kmap_ptbl(void)
+{
+    return (unsigned int) KMAP_TABLE;
+}
+
+// The number of times kmap moved a slot to another page.
+unsigned int kmap_get_nremaps(void)
+{
+    return KMAP_NREMAPS;
+}
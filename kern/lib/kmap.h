@@ -0,0 +1,28 @@
+#ifndef _KERN_LIB_KMAP_H_
+#define _KERN_LIB_KMAP_H_
+
+#ifdef _KERN_
+
+/**
+ * The kernel window: the page directory entry KMAP_PDE of every page
+ * structure points to the same supervisor-only page table, in which each CPU
+ * has KMAP_NSLOTS slots to map a physical page at a time. This is how the
+ * kernel reaches the normal pages (page tables, user pages) whatever page
+ * structure is loaded, since only the one of process 0 maps them.
+ * Each slot has a fixed use, so that the users of different slots can nest.
+ */
+#define KMAP_PDE    1022
+#define KMAP_NSLOTS 4
+
+#define KMAP_PDIR 0  // a page directory (MPTIntro)
+#define KMAP_PTBL 1  // a page table (MPTIntro)
+#define KMAP_SRC  2  // a page read from
+#define KMAP_DST  3  // a page written to
+
+void *kmap(unsigned int slot, unsigned int page_index);
+unsigned int kmap_ptbl(void);
+unsigned int kmap_get_nremaps(void);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_LIB_KMAP_H_ */
@@ -3,15 +3,21 @@
 
 #include <lib/debug.h>
 #include <lib/elf.h>
+#include <lib/kmap.h>
 #include <lib/types.h>
 #include <lib/gcc.h>
 #include <lib/string.h>
 #include <lib/x86.h>
 #include <lib/monitor.h>
+#include <lib/trap.h>
 #include <dev/console.h>
+#include <pmm/MATIntro/export.h>
+#include <pmm/MATCache/export.h>
+#include <pmm/MSlab/export.h>
 #include <pmm/MContainer/export.h>
 #include <vmm/MPTIntro/export.h>
 #include <vmm/MPTNew/export.h>
+#include <vmm/MPTReclaim/export.h>
 
 #define CMDBUF_SIZE 80  // enough for one VGA text line
 
@@ -26,6 +32,9 @@ static struct Command commands[] = {
     {"help", "Display this list of commands", mon_help},
     {"kerninfo", "Display information about the kernel", mon_kerninfo},
     {"backtrace", "Print a stack trace", mon_backtrace},
+    {"meminfo", "Display physical memory usage", mon_meminfo},
+    {"slabinfo", "Display the statistics of the slab caches", mon_slabinfo},
+    {"trapstat", "Display the page fault and TLB counters", mon_trapstat},
 };
 
 #define NCOMMANDS (sizeof(commands) / sizeof(commands[0]))
@@ -76,6 +85,68 @@ int mon_backtrace(int argc, char **argv, struct Trapframe *tf)
     return 0;
 }
 
+int mon_meminfo(int argc, char **argv, struct Trapframe *tf)
+{
+    unsigned int cpu_idx, ncached, nzeroed, hits, misses;
+
+    ncached = nzeroed = hits = misses = 0;
+    for (cpu_idx = 0; cpu_idx < NUM_CPUS; cpu_idx++) {
+        ncached += pcache_get_npages(cpu_idx);
+        nzeroed += pzero_get_npages(cpu_idx);
+        hits += pzero_get_hits(cpu_idx);
+        misses += pzero_get_misses(cpu_idx);
+    }
+
+    dprintf("Physical pages:      %d\n", get_nps());
+    dprintf("  normal             %d\n", at_get_nnorm());
+    dprintf("  free               %d\n", at_get_nfree());
+    dprintf("  allocated          %d\n", at_get_nallocated());
+    dprintf("  cached per-CPU     %d\n", ncached);
+    dprintf("  pre-zeroed         %d (%d hits, %d misses)\n",
+            nzeroed, hits, misses);
+    dprintf("Compressed store     %d pages in %d bytes\n",
+            reclaim_get_nstored(), reclaim_get_nbytes());
+    dprintf("  evicted            %d\n", reclaim_get_nevicted());
+    dprintf("  restored           %d\n", reclaim_get_nrestored());
+    dprintf("Root container quota %d, usage %d\n",
+            container_get_quota(0), container_get_usage(0));
+    return 0;
+}
+
+int mon_trapstat(int argc, char **argv, struct Trapframe *tf)
+{
+    unsigned int npgflt = trap_get_npgflt();
+    uint64_t cycles = trap_get_pgflt_cycles();
+
+    dprintf("Page faults          %d\n", npgflt);
+    if (npgflt > 0) {
+        dprintf("  cycles per fault   %llu\n", cycles / npgflt);
+    }
+    dprintf("CR3 loads            %d (%d skipped)\n",
+            pdir_get_nloads(), pdir_get_nskipped());
+    dprintf("TLB invalidations    %d pages, %d full flushes\n",
+            tlb_get_ninvlpg(), tlb_get_nflushes());
+    dprintf("Kernel window remaps %d\n", kmap_get_nremaps());
+    return 0;
+}
+
+int mon_slabinfo(int argc, char **argv, struct Trapframe *tf)
+{
+    unsigned int cache_id;
+
+    dprintf("%-14s %6s %6s %8s %10s %10s\n",
+            "name", "size", "slabs", "active", "allocs", "frees");
+    for (cache_id = 0; cache_id < slab_get_ncaches(); cache_id++) {
+        if (!slab_is_used(cache_id))
+            continue;
+        dprintf("%-14s %6d %6d %8d %10d %10d\n", slab_get_name(cache_id),
+                slab_get_size(cache_id), slab_get_nslabs(cache_id),
+                slab_get_nactive(cache_id), slab_get_nallocs(cache_id),
+                slab_get_nfrees(cache_id));
+    }
+    return 0;
+}
+
 unsigned int CID = 0;
 extern uint8_t _binary___obj_proc_dummy_dummy_start[];
 
@@ -83,21 +154,38 @@ typedef void (*entry_t)(void);
 
 int mon_start_user(int argc, char **argv, struct Trapframe *tf)
 {
+    unsigned int npages, pid;
+
+    // tear down the previous instance, so that the program can run again
     if (CID != 0) {
-        dprintf("The process is already running. "
-                 "If you want to run the program again, please restart qemu.\n");
-        return 0;
+        npages = pdir_destroy(CID);
+        if (npages == MagicNumber) {
+            // its address space may be gone already, so it is not run again
+            dprintf("Process %d cannot be destroyed, it is abandoned.\n", CID);
+        } else {
+            dprintf("Process %d is destroyed (%d pages released).\n", CID, npages);
+        }
+        CID = 0;
     }
 
     uint8_t *exe = _binary___obj_proc_dummy_dummy_start;
-    CID = alloc_mem_quota(0, container_get_quota(0));
-    elf_load(exe, CID);
+    // all that the kernel has not used yet
+    pid = alloc_mem_quota(0, container_get_quota(0) - container_get_usage(0));
+    if (pid == NUM_IDS) {
+        dprintf("No process can be created.\n");
+        return 0;
+    }
+    CID = pid;
+    elf_load_lazy(exe, CID);
     dprintf("Program 0x%08x is loaded.\n", exe);
 
     set_pdir_base(CID);
     entry_t entry = (entry_t) elf_entry(exe);
     entry();
 
+    // back to the kernel page structure, which the monitor loop relies on
+    set_pdir_base(0);
+
     return 0;
 }
 
@@ -153,6 +241,8 @@ void monitor(struct Trapframe *tf)
     dprintf("Type 'help' for a list of commands.\n");
 
     while (1) {
+        // refill the pre-zeroed page pool while waiting for the next command
+        pzero_refill();
         buf = (char *) readline("$> ");
         if (buf != NULL)
             if (runcmd(buf, tf) < 0)
@@ -1,3 +1,4 @@
+#include <lib/kmap.h>
 #include <lib/pmap.h>
 #include <lib/string.h>
 #include <lib/types.h>
@@ -5,6 +6,8 @@
 #define PTE_P 0x001  /* Present */
 #define PTE_W 0x002  /* Writeable */
 #define PTE_U 0x004  /* User-accessible */
+#define PTE_COW 0x800  /* Copy-on-write */
+#define PTE_ZSWAP 0x200  /* In the compressed store */
 
 #define PAGESIZE 4096
 
@@ -13,44 +16,154 @@
 
 extern void alloc_page(unsigned int pid, unsigned int vaddr,
                        unsigned int perm);
+extern unsigned int get_ptbl_entries_by_va(unsigned int pid, unsigned int vaddr,
+                                           unsigned int *ptes, unsigned int n);
+extern unsigned int at_is_norm(unsigned int page_index);
 extern unsigned int get_ptbl_entry_by_va(unsigned int pid,
                                          unsigned int vaddr);
+extern unsigned int cow_fault(unsigned int pid, unsigned int vaddr);
+extern unsigned int swap_in(unsigned int pid, unsigned int vaddr);
+extern int elf_fault(int pid, uintptr_t va);
+extern unsigned int pdir_is_active(unsigned int proc_index);
+
+/* What pt_copy does with each run of user memory. */
+#define PT_COPYIN  0
+#define PT_COPYOUT 1
+#define PT_MEMSET  2
+
+/* The number of page table entries pt_copy reads at once. */
+#define PT_BATCH 32
+
+/*
+ * Makes the page at va present (and private, if write is set) as a page
+ * fault would, and returns its page table entry.
+ */
+static uint32_t pt_fault(uint32_t pmap_id, uintptr_t va, int write)
+{
+    uint32_t pte = get_ptbl_entry_by_va(pmap_id, va);
 
-size_t pt_copyin(uint32_t pmap_id, uintptr_t uva, void *kva, size_t len)
+    if ((pte & PTE_P) == 0) {
+        if (pte & PTE_ZSWAP) {
+            swap_in(pmap_id, va);
+        } else if (elf_fault(pmap_id, va) == 0) {
+            alloc_page(pmap_id, va, PTE_P | PTE_U | PTE_W);
+        }
+        pte = get_ptbl_entry_by_va(pmap_id, va);
+    } else if (write && (pte & PTE_COW)) {
+        cow_fault(pmap_id, va);
+        pte = get_ptbl_entry_by_va(pmap_id, va);
+    }
+    return pte;
+}
+
+/* Applies op to the len bytes at va, and returns where kva continues. */
+static char *pt_run_va(int op, char *va, char *kva, char c, size_t len)
 {
-    if (!(VM_USERLO <= uva && uva + len <= VM_USERHI))
-        return 0;
+    if (op == PT_COPYIN)
+        memcpy(kva, va, len);
+    else if (op == PT_COPYOUT)
+        memcpy(va, kva, len);
+    else
+        memset(va, c, len);
+    return (op == PT_MEMSET) ? kva : kva + len;
+}
 
-    if ((uintptr_t) kva + len > VM_USERHI)
-        return 0;
+/*
+ * Applies op to the len bytes at physical address pa, mapped at uva in
+ * pmap_id, and returns where the kernel buffer continues.
+ * If pmap_id is the loaded page structure, the bytes are reached at uva;
+ * otherwise they go through the kernel window one page at a time.
+ */
+static char *pt_run(int op, uint32_t pmap_id, uintptr_t uva, uintptr_t pa,
+                    char *kva, char c, size_t len)
+{
+    size_t size;
 
-    size_t copied = 0;
+    if (pdir_is_active(pmap_id))
+        return pt_run_va(op, (char *) uva, kva, c, len);
 
     while (len) {
-        uintptr_t uva_pa = get_ptbl_entry_by_va(pmap_id, uva);
+        size = (len < PAGESIZE - pa % PAGESIZE) ? len : PAGESIZE - pa % PAGESIZE;
+        kva = pt_run_va(op, (char *) kmap(KMAP_DST, pa / PAGESIZE) + pa % PAGESIZE,
+                        kva, c, size);
+        pa += size;
+        len -= size;
+    }
+    return kva;
+}
 
-        if ((uva_pa & PTE_P) == 0) {
-            alloc_page(pmap_id, uva, PTE_P | PTE_U | PTE_W);
-            uva_pa = get_ptbl_entry_by_va(pmap_id, uva);
+/*
+ * Applies op to the len bytes of user memory at uva.
+ * The page table entries are read PT_BATCH at a time (see
+ * get_ptbl_entries_by_va), so the page directory entry is not looked up for
+ * every page; they are read again after a page is faulted in. Pages that are
+ * physically contiguous are merged into a single run, handed to memcpy or
+ * memset at once.
+ * Only writable pages of normal memory are written: a copy-on-write page is
+ * made private first, and a read-only page (e.g., one mapped to the kernel
+ * image by the ELF loader) stops the copy.
+ * Returns the number of bytes done, which is less than len only if a page
+ * cannot be faulted in or written.
+ */
+static size_t pt_copy(int op, uint32_t pmap_id, uintptr_t uva, char *kva,
+                      char c, size_t len)
+{
+    uint32_t ptes[PT_BATCH], pte, i, n;
+    uintptr_t run_pa, run_uva, pa;
+    size_t run_len, size, done;
+    int write = (op != PT_COPYIN);
+
+    done = 0;
+    run_pa = 0;
+    run_uva = 0;
+    run_len = 0;
+    i = n = 0;
+    while (len) {
+        if (i == n) {
+            n = get_ptbl_entries_by_va(pmap_id, uva, ptes, PT_BATCH);
+            i = 0;
         }
+        pte = ptes[i++];
+
+        if ((pte & PTE_P) == 0 || (write && (pte & PTE_COW))) {
+            /* the fault may evict pages, including the ones of the run */
+            if (run_len != 0) {
+                kva = pt_run(op, pmap_id, run_uva, run_pa, kva, c, run_len);
+                run_len = 0;
+            }
+            pte = pt_fault(pmap_id, uva, write);
+            i = n = 0;
+            if ((pte & PTE_P) == 0)
+                break;
+        }
+        if (write && ((pte & PTE_W) == 0 || !at_is_norm(pte / PAGESIZE)))
+            break;
 
-        uva_pa = (uva_pa & 0xfffff000) + (uva % PAGESIZE);
-
-        size_t size = (len < PAGESIZE - uva_pa % PAGESIZE) ?
-            len : PAGESIZE - uva_pa % PAGESIZE;
+        pa = (pte & 0xfffff000) + (uva % PAGESIZE);
+        size = (len < PAGESIZE - pa % PAGESIZE) ?
+            len : PAGESIZE - pa % PAGESIZE;
 
-        memcpy(kva, (void *) uva_pa, size);
+        if (run_len != 0 && run_pa + run_len != pa) {
+            kva = pt_run(op, pmap_id, run_uva, run_pa, kva, c, run_len);
+            run_len = 0;
+        }
+        if (run_len == 0) {
+            run_pa = pa;
+            run_uva = uva;
+        }
+        run_len += size;
 
         len -= size;
         uva += size;
-        kva += size;
-        copied += size;
+        done += size;
     }
+    if (run_len != 0)
+        pt_run(op, pmap_id, run_uva, run_pa, kva, c, run_len);
 
-    return copied;
+    return done;
 }
 
-size_t pt_copyout(void *kva, uint32_t pmap_id, uintptr_t uva, size_t len)
+size_t pt_copyin(uint32_t pmap_id, uintptr_t uva, void *kva, size_t len)
 {
     if (!(VM_USERLO <= uva && uva + len <= VM_USERHI))
         return 0;
@@ -58,55 +171,21 @@ size_t pt_copyout(void *kva, uint32_t pmap_id, uintptr_t uva, size_t len)
     if ((uintptr_t) kva + len > VM_USERHI)
         return 0;
 
-    size_t copied = 0;
-
-    while (len) {
-        uintptr_t uva_pa = get_ptbl_entry_by_va(pmap_id, uva);
-
-        if ((uva_pa & PTE_P) == 0) {
-            alloc_page(pmap_id, uva, PTE_P | PTE_U | PTE_W);
-            uva_pa = get_ptbl_entry_by_va(pmap_id, uva);
-        }
-
-        uva_pa = (uva_pa & 0xfffff000) + (uva % PAGESIZE);
-
-        size_t size = (len < PAGESIZE - uva_pa % PAGESIZE) ?
-            len : PAGESIZE - uva_pa % PAGESIZE;
+    return pt_copy(PT_COPYIN, pmap_id, uva, kva, 0, len);
+}
 
-        memcpy((void *) uva_pa, kva, size);
+size_t pt_copyout(void *kva, uint32_t pmap_id, uintptr_t uva, size_t len)
+{
+    if (!(VM_USERLO <= uva && uva + len <= VM_USERHI))
+        return 0;
 
-        len -= size;
-        uva += size;
-        kva += size;
-        copied += size;
-    }
+    if ((uintptr_t) kva + len > VM_USERHI)
+        return 0;
 
-    return copied;
+    return pt_copy(PT_COPYOUT, pmap_id, uva, kva, 0, len);
 }
 
 size_t pt_memset(uint32_t pmap_id, uintptr_t va, char c, size_t len)
 {
-    size_t set = 0;
-
-    while (len) {
-        uintptr_t pa = get_ptbl_entry_by_va(pmap_id, va);
-
-        if ((pa & PTE_P) == 0) {
-            alloc_page(pmap_id, va, PTE_P | PTE_U | PTE_W);
-            pa = get_ptbl_entry_by_va(pmap_id, va);
-        }
-
-        pa = (pa & 0xfffff000) + (va % PAGESIZE);
-
-        size_t size = (len < PAGESIZE - pa % PAGESIZE) ?
-            len : PAGESIZE - pa % PAGESIZE;
-
-        memset((void *) pa, c, size);
-
-        len -= size;
-        va += size;
-        set += size;
-    }
-
-    return set;
+    return pt_copy(PT_MEMSET, pmap_id, va, NULL, c, len);
 }
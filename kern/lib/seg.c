@@ -14,6 +14,14 @@ char STACK_LOC[64][4096] gcc_aligned(4096);
 segdesc_t gdt_LOC[CPU_GDT_NDESC];
 tss_t tss_LOC[64];
 
+/*
+ * The per-CPU data. CPU # i has the segment CPU_GDT_PCPU + 8 * i in %gs, so
+ * that get_pcpu_idx does not have to ask the local APIC, whose IDs are
+ * neither dense nor bounded by NUM_CPUS. The indices follow the order in
+ * which the CPUs are brought up, the boot CPU being CPU # 0.
+ */
+pcpu_t pcpu_LOC[NUM_CPUS];
+
 void seg_init(void)
 {
     /* clear BSS */
@@ -42,12 +50,20 @@ void seg_init(void)
         SEGDESC16(STS_T32A, (uint32_t) (&tss0), sizeof(tss_t) - 1, 0);
     gdt_LOC[CPU_GDT_TSS >> 3].sd_s = 0;
 
+    /* 0x30 + 8 * i: per-CPU data of CPU # i */
+    unsigned int cpu_idx;
+    for (cpu_idx = 0; cpu_idx < NUM_CPUS; cpu_idx++) {
+        pcpu_LOC[cpu_idx].idx = cpu_idx;
+        gdt_LOC[(CPU_GDT_PCPU >> 3) + cpu_idx] =
+            SEGDESC32(STA_W, (uint32_t) &pcpu_LOC[cpu_idx], sizeof(pcpu_t) - 1, 0);
+    }
+
     pseudodesc_t gdt_desc = {
         .pd_lim = sizeof(gdt_LOC) - 1,
         .pd_base = (uint32_t) gdt_LOC
     };
     asm volatile ("lgdt %0" :: "m" (gdt_desc));
-    asm volatile ("movw %%ax,%%gs" :: "a" (CPU_GDT_KDATA));
+    asm volatile ("movw %%ax,%%gs" :: "a" (CPU_GDT_PCPU));
     asm volatile ("movw %%ax,%%fs" :: "a" (CPU_GDT_KDATA));
     asm volatile ("movw %%ax,%%es" :: "a" (CPU_GDT_KDATA));
     asm volatile ("movw %%ax,%%ds" :: "a" (CPU_GDT_KDATA));
@@ -81,7 +81,8 @@ typedef struct pseudodesc {
 #define CPU_GDT_UCODE 0x18  /* user text */
 #define CPU_GDT_UDATA 0x20  /* user data */
 #define CPU_GDT_TSS   0x28  /* task state segment */
-#define CPU_GDT_NDESC 6     /* number of GDT entries used */
+#define CPU_GDT_PCPU  0x30  /* per-CPU data of CPU # 0, the other CPUs follow */
+#define CPU_GDT_NDESC 14    /* number of GDT entries used (6 + NUM_CPUS) */
 
 #ifndef __ASSEMBLER__
 
@@ -176,6 +177,11 @@ typedef struct gatedesc {
     (gate).gd_off_31_16 = (uint32_t) (off) >> 16;   \
 }
 
+/* Per-CPU data, reached through %gs. */
+typedef struct pcpu {
+    uint32_t idx;  /* the index of the CPU, must come first (see get_pcpu_idx) */
+} pcpu_t;
+
 void seg_init(void);
 
 #endif  /* !__ASSEMBLER__ */
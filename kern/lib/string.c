@@ -1,20 +1,36 @@
 #include "string.h"
 #include "types.h"
 
+/*
+ * The bytes up to the first 4-byte boundary and after the last one are set
+ * one at a time, so that any buffer of more than a few bytes is mostly set
+ * with rep stosl, whatever its alignment and length.
+ */
 void *memset(void *v, int c, size_t n)
 {
-    if (n == 0)
-        return v;
-    if ((int) v % 4 == 0 && n % 4 == 0) {
-        c &= 0xFF;
-        c = (c << 24) | (c << 16) | (c << 8) | c;
-        asm volatile ("cld; rep stosl\n"
-                      :: "D" (v), "a" (c), "c" (n / 4)
-                      : "cc", "memory");
-    } else
+    char *p;
+    size_t count;
+
+    p = v;
+    c &= 0xFF;
+    count = (4 - (uintptr_t) p % 4) % 4;
+    if (n >= count + 4) {
+        n -= count;
         asm volatile ("cld; rep stosb\n"
-                      :: "D" (v), "a" (c), "c" (n)
+                      : "+D" (p), "+c" (count)
+                      : "a" (c)
                       : "cc", "memory");
+        count = n / 4;
+        asm volatile ("cld; rep stosl\n"
+                      : "+D" (p), "+c" (count)
+                      : "a" ((c << 24) | (c << 16) | (c << 8) | c)
+                      : "cc", "memory");
+        n %= 4;
+    }
+    asm volatile ("cld; rep stosb\n"
+                  : "+D" (p), "+c" (n)
+                  : "a" (c)
+                  : "cc", "memory");
     return v;
 }
 
@@ -51,9 +67,37 @@ void *memmove(void *dst, const void *src, size_t n)
     return dst;
 }
 
+/*
+ * Unlike memmove, the buffers must not overlap, so the copy always goes
+ * forward. When the source and the destination have the same alignment,
+ * the bytes up to the first 4-byte boundary and after the last one are copied
+ * one at a time, and everything in between with rep movsl, whatever the
+ * length. Otherwise, rep movsb is used throughout.
+ */
 void *memcpy(void *dst, const void *src, size_t n)
 {
-    return memmove(dst, src, n);
+    const char *s;
+    char *d;
+    size_t count;
+
+    s = src;
+    d = dst;
+    count = (4 - (uintptr_t) d % 4) % 4;
+    if ((uintptr_t) s % 4 == (uintptr_t) d % 4 && n >= count + 4) {
+        n -= count;
+        asm volatile ("cld; rep movsb\n"
+                      : "+D" (d), "+S" (s), "+c" (count)
+                      :: "cc", "memory");
+        count = n / 4;
+        asm volatile ("cld; rep movsl\n"
+                      : "+D" (d), "+S" (s), "+c" (count)
+                      :: "cc", "memory");
+        n %= 4;
+    }
+    asm volatile ("cld; rep movsb\n"
+                  : "+D" (d), "+S" (s), "+c" (n)
+                  :: "cc", "memory");
+    return dst;
 }
 
 int strncmp(const char *p, const char *q, size_t n)
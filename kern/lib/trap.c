@@ -1,13 +1,19 @@
 #include <lib/string.h>
+#include <lib/elf.h>
 #include <lib/trap.h>
 #include <lib/debug.h>
 #include <lib/x86.h>
 #include <dev/intr.h>
 #include <vmm/MPTIntro/export.h>
 #include <vmm/MPTNew/export.h>
+#include <vmm/MPTReclaim/export.h>
 
 extern unsigned int CID;
 
+// The number of page faults handled, and the cycles spent on them in trap.
+static unsigned int TRAP_NPGFLT;
+static uint64_t TRAP_PGFLT_CYCLES;
+
 static void trap_dump(tf_t *tf)
 {
     if (tf == NULL)
@@ -39,6 +45,7 @@ void pgflt_handler(tf_t *tf)
 {
     unsigned int errno;
     unsigned int fault_va;
+    unsigned int cow;
 
     errno = tf->err;
     fault_va = rcr2();
@@ -47,12 +54,42 @@ void pgflt_handler(tf_t *tf)
             fault_va, errno, CID, tf->eip);
 
     if (tf->err & PFE_PR) {
+        if (errno & PFE_WR) {
+            // a write to a page shared copy-on-write
+            cow = cow_fault(CID, fault_va);
+            if (cow == 1) {
+                return;
+            } else if (cow == MagicNumber) {
+                KERN_PANIC("Out of memory copying the page at va = 0x%08x.\n",
+                           fault_va);
+                return;
+            }
+        }
         KERN_PANIC("Permission denied: va = 0x%08x, errno = 0x%08x.\n",
                    fault_va, errno);
         return;
     }
 
-    alloc_page(CID, rounddown(fault_va, PAGESIZE), PTE_W | PTE_U | PTE_P);
+    switch (swap_in(CID, fault_va)) {
+    case 1:
+        // a page that was evicted to the compressed store
+        return;
+    case MagicNumber:
+        KERN_PANIC("Out of memory restoring the page at va = 0x%08x.\n",
+                   fault_va);
+        return;
+    }
+
+    switch (elf_fault(CID, fault_va)) {
+    case 1:
+        // first touch of a lazily loaded ELF page
+        return;
+    case -1:
+        KERN_PANIC("Out of memory loading the page at va = 0x%08x.\n", fault_va);
+        return;
+    }
+
+    fault_around(CID, fault_va, PTE_W | PTE_U | PTE_P);
 }
 
 void checkpoint()
@@ -60,17 +97,38 @@ void checkpoint()
     KERN_INFO("check point\n");
 }
 
+unsigned int trap_get_npgflt(void)
+{
+    return TRAP_NPGFLT;
+}
+
+uint64_t trap_get_pgflt_cycles(void)
+{
+    return TRAP_PGFLT_CYCLES;
+}
+
+/**
+ * Page faults are handled in the page structure of the faulting process:
+ * the kernel is mapped in all of them (global and supervisor-only), and the
+ * handler reaches the page tables and the physical pages it works on through
+ * the self-map and the kernel window (see kmap), not through the identity map
+ * of process 0. So CR3 is not loaded, and the TLB entries of the process
+ * survive the fault. Any other trap is fatal.
+ */
 void trap(tf_t *tf)
 {
+    uint64_t start;
+
     if (tf->trapno == T_PGFLT) {
-        set_pdir_base(0);
+        start = rdtsc();
         pgflt_handler(tf);
+        TRAP_NPGFLT++;
+        TRAP_PGFLT_CYCLES += rdtsc() - start;
     } else {
         KERN_DEBUG("unhandled trap: %d\n", tf->trapno);
         trap_dump(tf);
         KERN_PANIC("stop!\n");
     }
 
-    set_pdir_base(CID);
     trap_return(tf);
 }
@@ -4,6 +4,7 @@
 #ifdef _KERN_
 
 #define PFE_PR 0x1  /* Page fault caused by protection violation */
+#define PFE_WR 0x2  /* Page fault caused by a write */
 
 typedef struct pushregs {
     uint32_t edi;
@@ -40,6 +41,10 @@ typedef struct tf_t {
 
 void trap_return(tf_t *tf);
 
+// The number of page faults handled, and the total cycles spent on them.
+unsigned int trap_get_npgflt(void);
+uint64_t trap_get_pgflt_cycles(void);
+
 #endif  /* _KERN_ */
 
 #endif  /* !_KERN_LIB_TRAP_H_ */
@@ -147,6 +147,11 @@ gcc_inline void lcr3(uint32_t val)
     __asm __volatile ("movl %0,%%cr3" :: "r" (val));
 }
 
+gcc_inline void invlpg(uintptr_t va)
+{
+    __asm __volatile ("invlpg (%0)" :: "r" (va) : "memory");
+}
+
 gcc_inline void lcr4(uint32_t val)
 {
     __asm __volatile ("movl %0,%%cr4" :: "r" (val));
@@ -16,6 +16,7 @@
 #define CR0_PG 0x80000000  /* Paging */
 
 /* CR4 */
+#define CR4_PSE        0x00000010  /* Page Size Extensions */
 #define CR4_PGE        0x00000080  /* Page Global Enable */
 #define CR4_OSFXSR     0x00000200  /* SSE and FXSAVE/FXRSTOR enable */
 #define CR4_OSXMMEXCPT 0x00000400  /* Unmasked SSE FP exceptions */
@@ -41,11 +42,16 @@
 #define PTE_PS   0x080  /* Page Size */
 #define PTE_G    0x100  /* Global */
 #define PTE_COW  0x800  /* Avail for system programmer's use */
+#define PTE_ZSWAP 0x200 /* Not present, the page is in the compressed store */
+#define PTE_SHM  0x400  /* Maps a page of a shared memory segment */
 
 /* other constants */
+#define NUM_CPUS     8
 #define NUM_IDS      64
 #define MagicNumber  1048577
-#define MAX_CHILDREN 3
+#define NUM_CONTAINERS 65536
+#define SHM_NSEGS    64
+#define SHM_MAX_PAGES 512  /* the page array of a segment is one kmalloc of at most 2KB */
 
 static inline uint32_t __attribute__ ((always_inline)) read_ebp(void)
 {
@@ -54,6 +60,18 @@ static inline uint32_t __attribute__ ((always_inline)) read_ebp(void)
     return ebp;
 }
 
+/*
+ * The index of the current CPU, in [0, NUM_CPUS). Each CPU has its own
+ * per-CPU segment in %gs, which starts with its index (see seg_init), so
+ * this is a single cached memory read.
+ */
+static inline uint32_t __attribute__ ((always_inline)) get_pcpu_idx(void)
+{
+    uint32_t idx;
+    __asm __volatile ("movl %%gs:0,%0" : "=r" (idx));
+    return idx;
+}
+
 void lldt(uint16_t sel);
 void cli(void);
 void sti(void);
@@ -74,6 +92,7 @@ void lcr0(uint32_t val);
 uint32_t rcr0(void);
 uint32_t rcr2(void);
 void lcr3(uint32_t val);
+void invlpg(uintptr_t va);
 void lcr4(uint32_t val);
 uint32_t rcr4(void);
 uint8_t inb(int port);
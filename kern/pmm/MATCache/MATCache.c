@@ -0,0 +1,177 @@
+#include <lib/debug.h>
+#include <lib/kmap.h>
+#include <lib/string.h>
+#include <lib/x86.h>
+#include "import.h"
+
+/**
+ * Each CPU keeps a magazine of free page indices in front of the MATOp layer,
+ * so that the common allocation and free paths only touch CPU-local data.
+ * An empty magazine is refilled with MAG_BATCH pages at once, and a full one
+ * drains its oldest MAG_BATCH pages back at once.
+ * Pages in a magazine are marked as allocated in the allocation table,
+ * but are not charged to any container.
+ */
+#define MAG_SIZE  64
+#define MAG_BATCH 32
+
+struct SMagazine {
+    unsigned int npages;               // the number of cached pages
+    unsigned int pages[MAG_SIZE];      // stack of cached page indices
+};
+
+static struct SMagazine MAGAZINE[NUM_CPUS];
+
+/**
+ * Each CPU also keeps a pool of pages that are already filled with zeros,
+ * for the page fault path.
+ * The pool is topped up by pzero_refill when the kernel is idle,
+ * and pcache_alloc_zeroed falls back to zeroing a page synchronously
+ * when the pool is empty.
+ * Pages in a pool are marked as allocated in the allocation table,
+ * but are not charged to any container.
+ */
+#define ZPOOL_SIZE 64
+
+struct SZeroPool {
+    unsigned int npages;               // the number of zeroed pages
+    unsigned int pages[ZPOOL_SIZE];    // stack of zeroed page indices
+    unsigned int hits;                 // allocations served from the pool
+    unsigned int misses;               // allocations zeroed synchronously
+};
+
+static struct SZeroPool ZPOOL[NUM_CPUS];
+
+static struct SMagazine *cur_magazine(void)
+{
+    unsigned int cpu_idx = get_pcpu_idx();
+    KERN_ASSERT(cpu_idx < NUM_CPUS);
+    return &MAGAZINE[cpu_idx];
+}
+
+static struct SZeroPool *cur_zpool(void)
+{
+    unsigned int cpu_idx = get_pcpu_idx();
+    KERN_ASSERT(cpu_idx < NUM_CPUS);
+    return &ZPOOL[cpu_idx];
+}
+
+/**
+ * Allocates a physical page from the magazine of the current CPU,
+ * refilling it from MATOp first if it is empty.
+ * Returns the page index, or 0 if there is no free page left.
+ */
+unsigned int pcache_alloc(void)
+{
+    struct SMagazine *mag = cur_magazine();
+
+    if (mag->npages == 0) {
+        mag->npages = palloc_batch(mag->pages, MAG_BATCH);
+        if (mag->npages == 0) {
+            return 0;
+        }
+    }
+
+    mag->npages--;
+    return mag->pages[mag->npages];
+}
+
+/**
+ * Frees a physical page into the magazine of the current CPU.
+ * If the magazine is full, its oldest MAG_BATCH pages go back to MATOp first.
+ * Nothing is done if the page is not an allocated normal page.
+ */
+void pcache_free(unsigned int page_index)
+{
+    struct SMagazine *mag;
+    unsigned int i;
+
+    if (!at_is_norm(page_index) || !at_is_allocated(page_index)) {
+        return;
+    }
+
+    mag = cur_magazine();
+    if (mag->npages == MAG_SIZE) {
+        pfree_batch(mag->pages, MAG_BATCH);
+        for (i = MAG_BATCH; i < MAG_SIZE; i++) {
+            mag->pages[i - MAG_BATCH] = mag->pages[i];
+        }
+        mag->npages -= MAG_BATCH;
+    }
+
+    mag->pages[mag->npages] = page_index;
+    mag->npages++;
+}
+
+static void pzero_page(unsigned int page_index)
+{
+    memzero(kmap(KMAP_DST, page_index), PAGESIZE);
+}
+
+/**
+ * Allocates a physical page filled with zeros.
+ * A page from the zeroed pool of the current CPU is used if there is one,
+ * otherwise a page is allocated with pcache_alloc and zeroed here.
+ * Returns the page index, or 0 if there is no free page left.
+ */
+unsigned int pcache_alloc_zeroed(void)
+{
+    struct SZeroPool *pool;
+    unsigned int page_index;
+
+    pool = cur_zpool();
+    if (pool->npages > 0) {
+        pool->hits++;
+        pool->npages--;
+        return pool->pages[pool->npages];
+    }
+
+    pool->misses++;
+    page_index = pcache_alloc();
+    if (page_index != 0) {
+        pzero_page(page_index);
+    }
+    return page_index;
+}
+
+/**
+ * Fills the zeroed pool of the current CPU up to ZPOOL_SIZE pages.
+ * This is meant to be called when the kernel has nothing better to do,
+ * e.g., while the monitor waits for a command.
+ */
+void pzero_refill(void)
+{
+    struct SZeroPool *pool;
+    unsigned int n, i;
+
+    pool = cur_zpool();
+    n = palloc_batch(&pool->pages[pool->npages], ZPOOL_SIZE - pool->npages);
+    for (i = 0; i < n; i++) {
+        pzero_page(pool->pages[pool->npages]);
+        pool->npages++;
+    }
+}
+
+// The number of zeroed pages in the pool of CPU # [cpu_idx].
+unsigned int pzero_get_npages(unsigned int cpu_idx)
+{
+    return ZPOOL[cpu_idx].npages;
+}
+
+// The number of zeroed page allocations on CPU # [cpu_idx] served from the pool.
+unsigned int pzero_get_hits(unsigned int cpu_idx)
+{
+    return ZPOOL[cpu_idx].hits;
+}
+
+// The number of zeroed page allocations on CPU # [cpu_idx] that missed the pool.
+unsigned int pzero_get_misses(unsigned int cpu_idx)
+{
+    return ZPOOL[cpu_idx].misses;
+}
+
+// The number of pages cached in the magazine of CPU # [cpu_idx].
+unsigned int pcache_get_npages(unsigned int cpu_idx)
+{
+    return MAGAZINE[cpu_idx].npages;
+}
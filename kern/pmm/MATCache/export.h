@@ -0,0 +1,17 @@
+#ifndef _KERN_PMM_MATCACHE_H_
+#define _KERN_PMM_MATCACHE_H_
+
+#ifdef _KERN_
+
+unsigned int pcache_alloc(void);
+void pcache_free(unsigned int page_index);
+unsigned int pcache_get_npages(unsigned int cpu_idx);
+unsigned int pcache_alloc_zeroed(void);
+void pzero_refill(void);
+unsigned int pzero_get_npages(unsigned int cpu_idx);
+unsigned int pzero_get_hits(unsigned int cpu_idx);
+unsigned int pzero_get_misses(unsigned int cpu_idx);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_PMM_MATCACHE_H_ */
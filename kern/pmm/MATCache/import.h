@@ -0,0 +1,21 @@
+#ifndef _KERN_PMM_MATCACHE_H_
+#define _KERN_PMM_MATCACHE_H_
+
+#ifdef _KERN_
+
+// Whether the page with the given index has normal permissions.
+unsigned int at_is_norm(unsigned int page_index);
+
+// Whether the page with the given index is already allocated.
+unsigned int at_is_allocated(unsigned int page_index);
+
+/**
+ * Batched allocation and free functions implemented in the MATOp layer.
+ * palloc_batch returns the number of pages actually allocated.
+ */
+unsigned int palloc_batch(unsigned int *pages, unsigned int n);
+void pfree_batch(unsigned int *pages, unsigned int n);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_PMM_MATCACHE_H_ */
@@ -0,0 +1,89 @@
+#include <lib/debug.h>
+#include <lib/x86.h>
+#include <pmm/MATIntro/export.h>
+#include "export.h"
+
+int MATCache_test1()
+{
+    unsigned int cpu_idx = get_pcpu_idx();
+    unsigned int page_index = pcache_alloc();
+    if (page_index == 0) {
+        dprintf("test 1.1 failed: (%d == 0)\n", page_index);
+        return 1;
+    }
+    if (at_is_allocated(page_index) != 1) {
+        dprintf("test 1.2 failed: (%d != 1)\n", at_is_allocated(page_index));
+        pcache_free(page_index);
+        return 1;
+    }
+    unsigned int npages = pcache_get_npages(cpu_idx);
+    pcache_free(page_index);
+    if (pcache_get_npages(cpu_idx) != npages + 1) {
+        dprintf("test 1.3 failed: (%d != %d)\n", pcache_get_npages(cpu_idx), npages + 1);
+        return 1;
+    }
+    if (pcache_alloc() != page_index) {
+        dprintf("test 1.4 failed: (the last freed page is not reused first)\n");
+        return 1;
+    }
+    pcache_free(page_index);
+    dprintf("test 1 passed.\n");
+    return 0;
+}
+
+int MATCache_test2()
+{
+    unsigned int i;
+    unsigned int cpu_idx = get_pcpu_idx();
+    unsigned int pages[100];
+    for (i = 0; i < 100; i++) {
+        pages[i] = pcache_alloc();
+    }
+    for (i = 0; i < 100; i++) {
+        pcache_free(pages[i]);
+    }
+    if (pcache_get_npages(cpu_idx) > 64) {
+        dprintf("test 2.1 failed: (%d > 64)\n", pcache_get_npages(cpu_idx));
+        return 1;
+    }
+    dprintf("test 2 passed.\n");
+    return 0;
+}
+
+int MATCache_test3()
+{
+    unsigned int i;
+    unsigned int cpu_idx = get_pcpu_idx();
+    unsigned int hits = pzero_get_hits(cpu_idx);
+    unsigned int page_index;
+    unsigned int *page;
+
+    pzero_refill();
+    if (pzero_get_npages(cpu_idx) == 0) {
+        dprintf("test 3.1 failed: (%d == 0)\n", pzero_get_npages(cpu_idx));
+        return 1;
+    }
+    page_index = pcache_alloc_zeroed();
+    if (page_index == 0 || pzero_get_hits(cpu_idx) != hits + 1) {
+        dprintf("test 3.2 failed: (%d == 0 || %d != %d)\n", page_index,
+                pzero_get_hits(cpu_idx), hits + 1);
+        pcache_free(page_index);
+        return 1;
+    }
+    page = (unsigned int *) (page_index * PAGESIZE);
+    for (i = 0; i < PAGESIZE / sizeof(unsigned int); i++) {
+        if (page[i] != 0) {
+            dprintf("test 3.3 failed (i = %d): (%d != 0)\n", i, page[i]);
+            pcache_free(page_index);
+            return 1;
+        }
+    }
+    pcache_free(page_index);
+    dprintf("test 3 passed.\n");
+    return 0;
+}
+
+int test_MATCache()
+{
+    return MATCache_test1() + MATCache_test2() + MATCache_test3();
+}
@@ -1,5 +1,6 @@
 #include <lib/debug.h>
 #include <lib/types.h>
+#include <lib/x86.h>
 #include "import.h"
 
 #define PAGESIZE     4096
@@ -8,6 +9,22 @@
 #define VM_USERLO_PI (VM_USERLO / PAGESIZE)
 #define VM_USERHI_PI (VM_USERHI / PAGESIZE)
 
+/**
+ * The permission of a page that is entirely contained in a memory map range,
+ * which is usable or not. Pages outside [VM_USERLO_PI, VM_USERHI_PI) are
+ * never normal: the usable ones are kernel only, and the others reserved.
+ */
+static unsigned int pmem_perm(unsigned int pg_idx, unsigned int usable)
+{
+    if (pg_idx < VM_USERLO_PI || VM_USERHI_PI <= pg_idx) {
+        return usable ? 1 : 0;
+    } else if (usable) {
+        return 2;
+    } else {
+        return 0;
+    }
+}
+
 /**
  * The initialization function for the allocation table AT.
  * It contains two major parts:
@@ -21,13 +38,16 @@
 void pmem_init(unsigned int mbi_addr)
 {
     unsigned int nps;
-    unsigned int pg_idx, pmmap_size, cur_addr, highest_addr;
-    unsigned int entry_idx, flag, isnorm, start, len;
+    unsigned int pg_idx, pmmap_size, cur_addr;
+    unsigned int entry_idx, usable, start, len, start_pi, end_pi;
+    uint64_t tsc;
 
     // Calls the lower layer initialization primitive.
     // The parameter mbi_addr should not be used in the further code.
     devinit(mbi_addr);
 
+    tsc = rdtsc();
+
     /**
      * Calculate the total number of physical pages provided by the hardware and
      * store it into the local variable nps.
@@ -56,44 +76,44 @@ void pmem_init(unsigned int mbi_addr)
      * The rest of the pages that correspond to addresses [VM_USERLO, VM_USERHI)
      * can be used freely ONLY IF the entire page falls into one of the ranges in
      * the memory map table with the permission marked as usable.
+     * Partial pages are not utilized.
      *
-     * Hint:
-     * 1. You have to initialize AT for all the page indices from 0 to NPS - 1.
-     * 2. For the pages that are reserved by the kernel, simply set its permission to 1.
-     *    Recall that the setter at_set_perm also marks the page as unallocated.
-     *    Thus, you don't have to call another function to set the allocation flag.
-     * 3. For the rest of the pages, explore the memory map table to set its permission
-     *    accordingly. The permission should be set to 2 only if there is a range
-     *    containing the entire page that is marked as available in the memory map table.
-     *    Otherwise, it should be set to 0. Note that the ranges in the memory map are
-     *    not aligned by pages, so it may be possible that for some pages, only some of
-     *    the addresses are in a usable range. Currently, we do not utilize partial pages,
-     *    so in that case, you should consider those pages as unavailable.
+     * The ranges in the memory map table are sorted by their start addresses,
+     * and a page is governed by the first range that contains it entirely.
+     * So the table is built with a single sweep over the ranges: pg_idx is the
+     * first page not decided yet, and every page below it is contained in an
+     * earlier range. Each range decides the pages it contains from pg_idx on,
+     * and the pages skipped over in between are not contained in any range.
+     * Every page is set exactly once.
      */
     pg_idx = 0;
-    while (pg_idx < nps) {
-        if (pg_idx < VM_USERLO_PI || VM_USERHI_PI <= pg_idx) {
-            at_set_perm(pg_idx, 1);
-        } else {
-            entry_idx = 0;
-            flag = 0;
-            isnorm = 0;
-            while (entry_idx < pmmap_size && !flag) {
-                isnorm = is_usable(entry_idx);
-                start = get_mms(entry_idx);
-                len = get_mml(entry_idx);
-                if (start <= pg_idx * PAGESIZE && (pg_idx + 1) * PAGESIZE <= start + len) {
-                    flag = 1;
-                }
-                entry_idx++;
-            }
+    entry_idx = 0;
+    while (entry_idx < pmmap_size && pg_idx < nps) {
+        start = get_mms(entry_idx);
+        len = get_mml(entry_idx);
+        usable = is_usable(entry_idx);
+
+        start_pi = start / PAGESIZE + (start % PAGESIZE != 0);
+        end_pi = (start + len) / PAGESIZE;
+        if (end_pi > nps) {
+            end_pi = nps;
+        }
 
-            if (flag && isnorm) {
-                at_set_perm(pg_idx, 2);
-            } else {
-                at_set_perm(pg_idx, 0);
-            }
+        while (pg_idx < start_pi && pg_idx < nps) {
+            at_set_perm(pg_idx, pmem_perm(pg_idx, 0));
+            pg_idx++;
+        }
+        while (pg_idx < end_pi) {
+            at_set_perm(pg_idx, pmem_perm(pg_idx, usable));
+            pg_idx++;
         }
+        entry_idx++;
+    }
+    while (pg_idx < nps) {
+        at_set_perm(pg_idx, pmem_perm(pg_idx, 0));
         pg_idx++;
     }
+
+    KERN_DEBUG("pmem_init: %d pages, %d memory map entries, %llu cycles.\n",
+               nps, pmmap_size, rdtsc() - tsc);
 }
@@ -29,6 +29,8 @@ unsigned int get_mms(unsigned int idx);    // The start address of the range wit
 unsigned int get_mml(unsigned int idx);    // The length of the range with given row index.
 unsigned int is_usable(unsigned int idx);  // Whether the range with given row index is usable by
                                            // the kernel. (0: reserved, 1: useable)
+int pmmap_lookup(unsigned int addr);       // The row index of the range containing the given
+                                           // address, or -1 if there is none.
 
 /**
  * Lower layer initialization function.
@@ -1,5 +1,6 @@
 #include <lib/debug.h>
 #include <pmm/MATIntro/export.h>
+#include "import.h"
 
 #define PAGESIZE     4096
 #define VM_USERLO    0x40000000
@@ -30,6 +31,35 @@ int MATInit_test1()
     return 0;
 }
 
+int MATInit_test2()
+{
+    unsigned int i, start, len;
+    int idx;
+
+    for (i = 0; i < get_size(); i++) {
+        start = get_mms(i);
+        len = get_mml(i);
+        if (len == 0) {
+            continue;
+        }
+        idx = pmmap_lookup(start + len / 2);
+        if (idx < 0 || start + len / 2 < get_mms(idx)
+            || start + len / 2 - get_mms(idx) >= get_mml(idx)) {
+            dprintf("test 2.1 failed (i = %d): (%d does not contain %x)\n",
+                    i, idx, start + len / 2);
+            return 1;
+        }
+    }
+    // the kernel image is loaded in usable memory
+    idx = pmmap_lookup((unsigned int) MATInit_test2);
+    if (idx < 0 || !is_usable(idx)) {
+        dprintf("test 2.2 failed: (the kernel is not in usable memory)\n");
+        return 1;
+    }
+    dprintf("test 2 passed.\n");
+    return 0;
+}
+
 /**
  * Write Your Own Test Script (optional)
  *
@@ -60,5 +90,5 @@ int MATInit_test_own()
 
 int test_MATInit()
 {
-    return MATInit_test1() + MATInit_test_own();
+    return MATInit_test1() + MATInit_test2() + MATInit_test_own();
 }
@@ -1,33 +1,93 @@
 #include <lib/gcc.h>
+#include <lib/debug.h>
 
 // Number of physical pages that are actually available in the machine.
 static unsigned int NUM_PAGES;
 
-/**
- * Structure representing information for one physical page.
- */
-struct ATStruct {
-    /**
-     * The permission of the page.
-     * 0: Reserved by the BIOS.
-     * 1: Kernel only.
-     * >1: Normal (available).
-     */
-    unsigned int perm;
-    /**
-     * Whether the page is allocated.
-     * 0: unallocated
-     * >0: allocated
-     */
-    unsigned int allocated;
-};
-
 /**
  * A 32 bit machine may have up to 4GB of memory.
  * So it may have up to 2^20 physical pages,
  * with the page size being 4KB.
  */
-static struct ATStruct AT[1 << 20];
+#define AT_NPAGES (1 << 20)
+#define AT_NWORDS (AT_NPAGES / 32)
+
+/**
+ * The physical allocation table (AT).
+ *
+ * AT_perm holds the permission of each page:
+ * 0: Reserved by the BIOS.
+ * 1: Kernel only.
+ * >1: Normal (available).
+ * Permissions above 255 are stored as 255, which does not change whether
+ * the page is normal.
+ *
+ * AT_allocated is a bitmap of the allocation flags (bit set: allocated).
+ * AT_free is a bitmap of the pages that are normal and unallocated.
+ * It is derived from the other two on every update, and lets the searches
+ * below skip 32 pages with a single comparison.
+ */
+static unsigned char AT_perm[AT_NPAGES];
+static unsigned int AT_allocated[AT_NWORDS];
+static unsigned int AT_free[AT_NWORDS];
+
+/**
+ * AT_refcnt holds the number of references to each allocated page, so that a
+ * page can be mapped by several processes at once (e.g., copy-on-write).
+ * Allocating a page sets it to 1, and the page should only be freed when
+ * the last reference is dropped.
+ */
+static unsigned short AT_refcnt[AT_NPAGES];
+
+/**
+ * Page counters, kept up to date by the setters below so that they can be
+ * read without scanning the table.
+ * AT_NNORM: the number of normal pages.
+ * AT_NALLOCATED: the number of allocated pages.
+ * AT_NFREE: the number of normal and unallocated pages.
+ */
+static unsigned int AT_NNORM;
+static unsigned int AT_NALLOCATED;
+static unsigned int AT_NFREE;
+
+// Returns the index of the least significant set bit of a nonzero word.
+static gcc_inline unsigned int bsf(unsigned int word)
+{
+    unsigned int idx;
+    __asm __volatile ("bsfl %1,%0" : "=r" (idx) : "rm" (word));
+    return idx;
+}
+
+/**
+ * Adds (sign = 1) or removes (sign = -1) the contribution of a page
+ * to the page counters.
+ * The setters remove it before changing the page, and add it back after.
+ */
+static void at_count(unsigned int page_index, int sign)
+{
+    unsigned int mask = 1u << (page_index % 32);
+
+    if (AT_perm[page_index] > 1) {
+        AT_NNORM += sign;
+    }
+    if (AT_allocated[page_index / 32] & mask) {
+        AT_NALLOCATED += sign;
+    }
+    if (AT_free[page_index / 32] & mask) {
+        AT_NFREE += sign;
+    }
+}
+
+static void at_update_free(unsigned int page_index)
+{
+    unsigned int mask = 1u << (page_index % 32);
+
+    if (AT_perm[page_index] > 1 && !(AT_allocated[page_index / 32] & mask)) {
+        AT_free[page_index / 32] |= mask;
+    } else {
+        AT_free[page_index / 32] &= ~mask;
+    }
+}
 
 // The getter function for NUM_PAGES.
 unsigned int get_nps(void)
@@ -50,7 +110,7 @@ unsigned int at_is_norm(unsigned int page_index)
 {
     unsigned int perm;
 
-    perm = AT[page_index].perm;
+    perm = AT_perm[page_index];
     if (perm > 1) {
         perm = 1;
     } else {
@@ -60,6 +120,15 @@ unsigned int at_is_norm(unsigned int page_index)
     return perm;
 }
 
+/**
+ * Whether the page with the given index is kernel only (permission 1),
+ * i.e., usable memory outside the range of the normal pages.
+ */
+unsigned int at_is_kern(unsigned int page_index)
+{
+    return AT_perm[page_index] == 1;
+}
+
 /**
  * The setter function for the physical page permission.
  * Sets the permission of the page with given index.
@@ -67,8 +136,12 @@ unsigned int at_is_norm(unsigned int page_index)
  */
 void at_set_perm(unsigned int page_index, unsigned int perm)
 {
-    AT[page_index].perm = perm;
-    AT[page_index].allocated = 0;
+    at_count(page_index, -1);
+    AT_perm[page_index] = perm > 255 ? 255 : perm;
+    AT_allocated[page_index / 32] &= ~(1u << (page_index % 32));
+    AT_refcnt[page_index] = 0;
+    at_update_free(page_index);
+    at_count(page_index, 1);
 }
 
 /**
@@ -77,21 +150,122 @@ void at_set_perm(unsigned int page_index, unsigned int perm)
  */
 unsigned int at_is_allocated(unsigned int page_index)
 {
-    unsigned int allocated;
+    return (AT_allocated[page_index / 32] >> (page_index % 32)) & 1;
+}
 
-    allocated = AT[page_index].allocated;
+/**
+ * The setter function for the physical page allocation flag.
+ * Set the flag of the page with given index to the given value.
+ * The reference count is set to 1 for an allocated page, and 0 otherwise.
+ */
+void at_set_allocated(unsigned int page_index, unsigned int allocated)
+{
+    at_count(page_index, -1);
     if (allocated > 0) {
-        allocated = 1;
+        AT_allocated[page_index / 32] |= 1u << (page_index % 32);
+        AT_refcnt[page_index] = 1;
+    } else {
+        AT_allocated[page_index / 32] &= ~(1u << (page_index % 32));
+        AT_refcnt[page_index] = 0;
     }
+    at_update_free(page_index);
+    at_count(page_index, 1);
+}
+
+// The getter function for the reference count of the page.
+unsigned int at_get_refcnt(unsigned int page_index)
+{
+    return AT_refcnt[page_index];
+}
 
-    return allocated;
+// The setter function for the reference count of the page.
+void at_set_refcnt(unsigned int page_index, unsigned int refcnt)
+{
+    AT_refcnt[page_index] = refcnt;
+}
+
+// Takes one more reference to the page.
+void at_inc_refcnt(unsigned int page_index)
+{
+    KERN_ASSERT(AT_refcnt[page_index] < 0xffff);
+    AT_refcnt[page_index]++;
 }
 
 /**
- * The setter function for the physical page allocation flag.
- * Set the flag of the page with given index to the given value.
+ * Drops one reference to the page.
+ * Returns the number of references left; the page can be freed when it is 0.
  */
-void at_set_allocated(unsigned int page_index, unsigned int allocated)
+unsigned int at_dec_refcnt(unsigned int page_index)
+{
+    if (AT_refcnt[page_index] > 0) {
+        AT_refcnt[page_index]--;
+    }
+    return AT_refcnt[page_index];
+}
+
+// The number of pages with the normal permission.
+unsigned int at_get_nnorm(void)
+{
+    return AT_NNORM;
+}
+
+// The number of allocated pages.
+unsigned int at_get_nallocated(void)
+{
+    return AT_NALLOCATED;
+}
+
+// The number of unallocated pages with the normal permission.
+unsigned int at_get_nfree(void)
+{
+    return AT_NFREE;
+}
+
+/**
+ * Searches [from, to) for the first page whose bit in AT_free equals
+ * the given value, 32 pages at a time.
+ * Returns the page index found, or to if there is none.
+ */
+static unsigned int at_search(unsigned int from, unsigned int to,
+                              unsigned int free)
+{
+    unsigned int word_idx, word;
+
+    if (from >= to) {
+        return to;
+    }
+
+    word_idx = from / 32;
+    word = free ? AT_free[word_idx] : ~AT_free[word_idx];
+    word &= ~0u << (from % 32);
+
+    while (word == 0) {
+        word_idx++;
+        if (word_idx * 32 >= to) {
+            return to;
+        }
+        word = free ? AT_free[word_idx] : ~AT_free[word_idx];
+    }
+
+    from = word_idx * 32 + bsf(word);
+    return from < to ? from : to;
+}
+
+/**
+ * Returns the index of the first normal and unallocated page in [from, to),
+ * or to if all of them are reserved or allocated.
+ */
+unsigned int at_next_free(unsigned int from, unsigned int to)
+{
+    return at_search(from, to, 1);
+}
+
+/**
+ * Returns the index of the first page in [from, to) that is not both
+ * normal and unallocated, or to if there is none.
+ * Together with at_next_free, it finds the runs of free pages.
+ */
+unsigned int at_next_nonfree(unsigned int from, unsigned int to)
 {
-    AT[page_index].allocated = allocated;
+    return at_search(from, to, 0);
 }
@@ -7,11 +7,24 @@ unsigned int get_nps(void);
 void set_nps(unsigned int page_index);
 
 unsigned int at_is_norm(unsigned int page_index);
+unsigned int at_is_kern(unsigned int page_index);
 void at_set_perm(unsigned int page_index, unsigned int perm);
 
 unsigned int at_is_allocated(unsigned int page_index);
 void at_set_allocated(unsigned int page_index, unsigned int allocated);
 
+unsigned int at_get_refcnt(unsigned int page_index);
+void at_set_refcnt(unsigned int page_index, unsigned int refcnt);
+void at_inc_refcnt(unsigned int page_index);
+unsigned int at_dec_refcnt(unsigned int page_index);
+
+unsigned int at_get_nnorm(void);
+unsigned int at_get_nallocated(void);
+unsigned int at_get_nfree(void);
+
+unsigned int at_next_free(unsigned int from, unsigned int to);
+unsigned int at_next_nonfree(unsigned int from, unsigned int to);
+
 #endif  /* _KERN_ */
 
 #endif  /* !_KERN_PMM_MATINTRO_H_ */
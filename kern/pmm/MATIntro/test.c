@@ -75,6 +75,82 @@ int MATIntro_test3()
     return 0;
 }
 
+int MATIntro_test4()
+{
+    at_set_perm(70, 2);
+    if (at_next_free(32, 96) != 70 || at_next_nonfree(70, 96) != 71) {
+        dprintf("test 4.1 failed: (%d != 70 || %d != 71)\n",
+                at_next_free(32, 96), at_next_nonfree(70, 96));
+        at_set_perm(70, 1);
+        return 1;
+    }
+    at_set_allocated(70, 1);
+    if (at_next_free(32, 96) != 96 || at_next_nonfree(70, 96) != 70) {
+        dprintf("test 4.2 failed: (%d != 96 || %d != 70)\n",
+                at_next_free(32, 96), at_next_nonfree(70, 96));
+        at_set_perm(70, 1);
+        return 1;
+    }
+    at_set_perm(70, 1);
+    if (at_next_free(32, 96) != 96) {
+        dprintf("test 4.3 failed: (%d != 96)\n", at_next_free(32, 96));
+        return 1;
+    }
+    dprintf("test 4 passed.\n");
+    return 0;
+}
+
+int MATIntro_test5()
+{
+    unsigned int nnorm = at_get_nnorm();
+    unsigned int nallocated = at_get_nallocated();
+    unsigned int nfree = at_get_nfree();
+    at_set_perm(70, 2);
+    if (at_get_nnorm() != nnorm + 1 || at_get_nfree() != nfree + 1) {
+        dprintf("test 5.1 failed: (%d != %d || %d != %d)\n",
+                at_get_nnorm(), nnorm + 1, at_get_nfree(), nfree + 1);
+        at_set_perm(70, 1);
+        return 1;
+    }
+    at_set_allocated(70, 1);
+    if (at_get_nallocated() != nallocated + 1 || at_get_nfree() != nfree) {
+        dprintf("test 5.2 failed: (%d != %d || %d != %d)\n",
+                at_get_nallocated(), nallocated + 1, at_get_nfree(), nfree);
+        at_set_perm(70, 1);
+        return 1;
+    }
+    at_set_perm(70, 1);
+    if (at_get_nnorm() != nnorm || at_get_nallocated() != nallocated
+        || at_get_nfree() != nfree) {
+        dprintf("test 5.3 failed: (%d != %d || %d != %d || %d != %d)\n",
+                at_get_nnorm(), nnorm, at_get_nallocated(), nallocated,
+                at_get_nfree(), nfree);
+        return 1;
+    }
+    dprintf("test 5 passed.\n");
+    return 0;
+}
+
+int MATIntro_test6()
+{
+    at_set_perm(70, 2);
+    at_set_allocated(70, 1);
+    if (at_get_refcnt(70) != 1) {
+        dprintf("test 6.1 failed: (%d != 1)\n", at_get_refcnt(70));
+        at_set_perm(70, 1);
+        return 1;
+    }
+    at_inc_refcnt(70);
+    if (at_get_refcnt(70) != 2 || at_dec_refcnt(70) != 1 || at_dec_refcnt(70) != 0) {
+        dprintf("test 6.2 failed: (the reference count is not 2, 1, then 0)\n");
+        at_set_perm(70, 1);
+        return 1;
+    }
+    at_set_perm(70, 1);
+    dprintf("test 6 passed.\n");
+    return 0;
+}
+
 /**
  * Write Your Own Test Script (optional)
  *
@@ -97,5 +173,5 @@ int MATIntro_test_own()
 
 int test_MATIntro()
 {
-    return MATIntro_test1() + MATIntro_test2() + MATIntro_test3() + MATIntro_test_own();
+    return MATIntro_test1() + MATIntro_test2() + MATIntro_test3() + MATIntro_test4() + MATIntro_test5() + MATIntro_test6() + MATIntro_test_own();
 }
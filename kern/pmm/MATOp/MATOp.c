@@ -8,68 +8,375 @@
 #define VM_USERLO_PI (VM_USERLO / PAGESIZE)
 #define VM_USERHI_PI (VM_USERHI / PAGESIZE)
 
-static unsigned int last_palloc_index = VM_USERLO_PI;
+/**
+ * The largest block handed out by the buddy allocator is 2^BUDDY_MAX_ORDER
+ * pages (4MB), i.e., the range covered by one page directory entry.
+ * Both VM_USERLO_PI and VM_USERHI_PI are aligned to it, so a block never
+ * straddles the boundary of the user physical range.
+ */
+#define BUDDY_MAX_ORDER 10
 
 /**
- * Allocate a physical page.
- *
- * 1. First, implement a naive page allocator that scans the allocation table (AT)
- *    using the functions defined in import.h to find the first unallocated page
- *    with normal permissions.
- *    (Q: Do you have to scan the allocation table from index 0? Recall how you have
- *    initialized the table in pmem_init.)
- *    Then mark the page as allocated in the allocation table and return the page
- *    index of the page found. In the case when there is no available page found,
- *    return 0.
- * 2. Optimize the code using memoization so that you do not have to
- *    scan the allocation table from scratch every time.
+ * List links of a free block.
+ * They are kept in free_link, by the index of the first page of the block,
+ * rather than in the free pages themselves: normal pages are not mapped in
+ * the page structures of the user processes, which the kernel may run in.
+ * Page indices are used instead of pointers; 0 terminates a list since
+ * page 0 is never a normal page.
  */
+struct buddy_link {
+    unsigned int next;
+    unsigned int prev;
+};
 
-unsigned int cursor = VM_USERLO_PI;
+static struct buddy_link free_link[VM_USERHI_PI - VM_USERLO_PI];
 
-unsigned int palloc()
+/**
+ * Kernel pages: the usable pages from the end of the kernel image up to
+ * VM_USERLO. Unlike the normal pages, they are identity mapped in every page
+ * structure, so they hold the kernel objects that must stay reachable
+ * whatever page structure is loaded (see MSlab).
+ * kpage_next is the first page never handed out, and the pages freed since
+ * are kept on kpage_list, linked through their first words.
+ */
+static unsigned int kpage_next;
+static unsigned int kpage_list;
+
+// The kernel pages start right after the kernel image.
+static void kpage_init(void)
 {
-    unsigned int nps;
-    unsigned int palloc_index;
-    unsigned int palloc_free_index;
-    bool first;
+    extern uint8_t end[];
 
-    nps = get_nps();
-    palloc_index = last_palloc_index;
-    palloc_free_index = nps;
-    first = TRUE;
-
-    while ((palloc_index != last_palloc_index || first) && palloc_free_index == nps) {
-        first = FALSE;
-        if (at_is_norm(palloc_index) && !at_is_allocated(palloc_index)) {
-            palloc_free_index = palloc_index;
+    kpage_next = ROUNDUP((uintptr_t) end, PAGESIZE) / PAGESIZE;
+    kpage_list = 0;
+}
+
+// The first page of the free blocks of each order (0 if the list is empty).
+static unsigned int free_list[BUDDY_MAX_ORDER + 1];
+
+/**
+ * For the first page of a free block of order k, free_order is k + 1.
+ * It is 0 for all the other pages, allocated or not.
+ * This is what tells us whether the buddy of a freed block can be merged.
+ */
+static unsigned char free_order[1 << 20];
+
+static struct buddy_link *buddy_link(unsigned int page_index)
+{
+    return &free_link[page_index - VM_USERLO_PI];
+}
+
+// Pushes the free block starting at page_index to the free list of the order.
+static void buddy_push(unsigned int page_index, unsigned int order)
+{
+    struct buddy_link *link;
+    unsigned int head;
+
+    head = free_list[order];
+    link = buddy_link(page_index);
+    link->next = head;
+    link->prev = 0;
+    if (head != 0) {
+        buddy_link(head)->prev = page_index;
+    }
+    free_list[order] = page_index;
+    free_order[page_index] = order + 1;
+}
+
+// Unlinks the free block starting at page_index from the free list of the order.
+static void buddy_remove(unsigned int page_index, unsigned int order)
+{
+    struct buddy_link *link;
+
+    link = buddy_link(page_index);
+    if (link->prev != 0) {
+        buddy_link(link->prev)->next = link->next;
+    } else {
+        free_list[order] = link->next;
+    }
+    if (link->next != 0) {
+        buddy_link(link->next)->prev = link->prev;
+    }
+    free_order[page_index] = 0;
+}
+
+/**
+ * Returns the block of 2^order pages starting at page_index to the free lists,
+ * merging it with its buddy for as long as the buddy is free as a whole.
+ */
+static void buddy_free_block(unsigned int page_index, unsigned int order)
+{
+    unsigned int buddy;
+
+    while (order < BUDDY_MAX_ORDER) {
+        buddy = page_index ^ (1 << order);
+        if (free_order[buddy] != order + 1) {
+            break;
         }
-        palloc_index++;
-        if (palloc_index >= VM_USERHI_PI) {
-            palloc_index = VM_USERLO_PI;
+        buddy_remove(buddy, order);
+        page_index &= ~(1 << order);
+        order++;
+    }
+    buddy_push(page_index, order);
+}
+
+/**
+ * Returns the n pages starting at page_index to the free lists.
+ * The range is carved into the largest naturally aligned blocks it contains.
+ */
+static void buddy_free_range(unsigned int page_index, unsigned int n)
+{
+    unsigned int order;
+
+    while (n > 0) {
+        order = 0;
+        while (order < BUDDY_MAX_ORDER
+               && page_index % (1 << (order + 1)) == 0
+               && (1 << (order + 1)) <= n) {
+            order++;
         }
+        buddy_free_block(page_index, order);
+        page_index += 1 << order;
+        n -= 1 << order;
     }
+}
 
-    if (palloc_free_index == nps) {
-        palloc_free_index = 0;
-        last_palloc_index = VM_USERLO_PI;
-    } else {
-        at_set_allocated(palloc_free_index, 1);
-        last_palloc_index = palloc_free_index;
+/**
+ * Initializes the physical allocation table (with pmem_init), then hands every
+ * run of unallocated normal pages in [VM_USERLO_PI, VM_USERHI_PI)
+ * to the buddy allocator. The kernel pages are handed out as they are asked for.
+ */
+void palloc_init(unsigned int mbi_addr)
+{
+    unsigned int nps, pg_idx, run_end, end;
+
+    pmem_init(mbi_addr);
+    kpage_init();
+
+    nps = get_nps();
+    end = nps < VM_USERHI_PI ? nps : VM_USERHI_PI;
+    pg_idx = at_next_free(VM_USERLO_PI, end);
+    while (pg_idx < end) {
+        run_end = at_next_nonfree(pg_idx, end);
+        buddy_free_range(pg_idx, run_end - pg_idx);
+        pg_idx = at_next_free(run_end, end);
+    }
+}
+
+/**
+ * Allocates 2^order physically contiguous pages.
+ *
+ * The block is taken from the smallest nonempty free list of an order >= the
+ * requested one, and the unused halves are split off back to the lower lists.
+ * All the pages of the block are marked as allocated in the allocation table.
+ * Returns the index of the first page, which is aligned to 2^order,
+ * or 0 if there is no such free block.
+ */
+unsigned int palloc_order(unsigned int order)
+{
+    unsigned int page_index, cur_order, i;
+
+    if (order > BUDDY_MAX_ORDER) {
+        return 0;
+    }
+
+    cur_order = order;
+    while (cur_order <= BUDDY_MAX_ORDER && free_list[cur_order] == 0) {
+        cur_order++;
+    }
+    if (cur_order > BUDDY_MAX_ORDER) {
+        return 0;
+    }
+
+    page_index = free_list[cur_order];
+    buddy_remove(page_index, cur_order);
+    while (cur_order > order) {
+        cur_order--;
+        buddy_push(page_index + (1 << cur_order), cur_order);
+    }
+
+    for (i = 0; i < (1 << order); i++) {
+        at_set_allocated(page_index + i, 1);
+    }
+
+    return page_index;
+}
+
+/**
+ * Frees the block of 2^order pages starting at page_index,
+ * which should have been returned by palloc_order with the same order.
+ * Nothing is done if the first page is not an allocated normal page,
+ * so freeing a page twice is harmless.
+ */
+void pfree_order(unsigned int page_index, unsigned int order)
+{
+    unsigned int i;
+
+    if (order > BUDDY_MAX_ORDER
+        || !at_is_norm(page_index) || !at_is_allocated(page_index)) {
+        return;
     }
 
-    return palloc_free_index;
+    for (i = 0; i < (1 << order); i++) {
+        at_set_allocated(page_index + i, 0);
+    }
+    buddy_free_block(page_index, order);
+}
+
+/**
+ * Allocates n physically contiguous pages, where 0 < n <= 2^BUDDY_MAX_ORDER.
+ *
+ * The smallest buddy block that can hold n pages is allocated, and the pages
+ * past the first n are returned to the free lists right away, so a request
+ * costs a single block allocation no matter how many pages it asks for.
+ * Returns the index of the first page, or 0 if no such range is available.
+ */
+unsigned int palloc_range(unsigned int n)
+{
+    unsigned int page_index, order, i;
+
+    if (n == 0 || n > (1 << BUDDY_MAX_ORDER)) {
+        return 0;
+    }
+
+    order = 0;
+    while ((1 << order) < n) {
+        order++;
+    }
+
+    page_index = palloc_order(order);
+    if (page_index == 0) {
+        return 0;
+    }
+
+    for (i = n; i < (1 << order); i++) {
+        at_set_allocated(page_index + i, 0);
+    }
+    buddy_free_range(page_index + n, (1 << order) - n);
+
+    return page_index;
+}
+
+/**
+ * Frees the n pages starting at page_index, e.g., a range returned by
+ * palloc_range.
+ * Pages in the range that are not allocated normal pages are skipped,
+ * and the others are returned to the free lists in maximal runs.
+ */
+void pfree_range(unsigned int page_index, unsigned int n)
+{
+    unsigned int i, run_start;
+
+    i = 0;
+    while (i < n) {
+        if (!at_is_norm(page_index + i) || !at_is_allocated(page_index + i)) {
+            i++;
+            continue;
+        }
+        run_start = i;
+        while (i < n && at_is_norm(page_index + i) && at_is_allocated(page_index + i)) {
+            at_set_allocated(page_index + i, 0);
+            i++;
+        }
+        buddy_free_range(page_index + run_start, i - run_start);
+    }
+}
+
+/**
+ * Allocate a physical page.
+ *
+ * Returns the index of an unallocated page with normal permissions and marks
+ * it as allocated in the allocation table.
+ * In the case when there is no available page, returns 0.
+ */
+unsigned int palloc()
+{
+    return palloc_order(0);
 }
 
 /**
  * Free a physical page.
  *
  * This function marks the page with given index as unallocated
- * in the allocation table.
- *
- * Hint: Simple.
+ * in the allocation table, and returns it to the buddy allocator.
  */
 void pfree(unsigned int pfree_index)
 {
-    at_set_allocated(pfree_index, 0);
+    pfree_order(pfree_index, 0);
+}
+
+/**
+ * Allocates up to n pages, storing their indices in pages.
+ * This is how the per-CPU caches refill, so that they reach the allocation
+ * table once per batch rather than once per page.
+ * Returns the number of pages allocated, which is less than n only if
+ * physical memory runs out.
+ */
+unsigned int palloc_batch(unsigned int *pages, unsigned int n)
+{
+    unsigned int i, page_index;
+
+    i = 0;
+    while (i < n) {
+        page_index = palloc_order(0);
+        if (page_index == 0) {
+            break;
+        }
+        pages[i] = page_index;
+        i++;
+    }
+
+    return i;
+}
+
+// Frees the n pages whose indices are stored in pages.
+void pfree_batch(unsigned int *pages, unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        pfree_order(pages[i], 0);
+    }
+}
+
+/**
+ * Allocates a kernel page, and marks it as allocated in the allocation table.
+ * Returns its index, or 0 if there is no kernel page left.
+ */
+unsigned int kpalloc(void)
+{
+    unsigned int page_index;
+
+    if (kpage_list != 0) {
+        page_index = kpage_list;
+        kpage_list = *(unsigned int *) (page_index * PAGESIZE);
+    } else {
+        while (kpage_next < VM_USERLO_PI && !at_is_kern(kpage_next)) {
+            kpage_next++;
+        }
+        if (kpage_next == VM_USERLO_PI) {
+            return 0;
+        }
+        page_index = kpage_next;
+        kpage_next++;
+    }
+
+    at_set_allocated(page_index, 1);
+    return page_index;
+}
+
+/**
+ * Frees a page returned by kpalloc.
+ * Nothing is done if the page is not an allocated kernel page.
+ */
+void kpfree(unsigned int page_index)
+{
+    if (page_index >= kpage_next || !at_is_kern(page_index)
+        || !at_is_allocated(page_index)) {
+        return;
+    }
+
+    at_set_allocated(page_index, 0);
+    *(unsigned int *) (page_index * PAGESIZE) = kpage_list;
+    kpage_list = page_index;
 }
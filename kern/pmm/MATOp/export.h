@@ -3,8 +3,17 @@
 
 #ifdef _KERN_
 
+void palloc_init(unsigned int mbi_addr);
 unsigned int palloc(void);
 void pfree(unsigned int pfree_index);
+unsigned int palloc_order(unsigned int order);
+void pfree_order(unsigned int page_index, unsigned int order);
+unsigned int palloc_range(unsigned int n);
+void pfree_range(unsigned int page_index, unsigned int n);
+unsigned int palloc_batch(unsigned int *pages, unsigned int n);
+void pfree_batch(unsigned int *pages, unsigned int n);
+unsigned int kpalloc(void);
+void kpfree(unsigned int page_index);
 
 #endif  /* _KERN_ */
 
@@ -13,12 +13,27 @@ unsigned int get_nps(void);
 // Whether the page with the given index has normal permissions.
 unsigned int at_is_norm(unsigned int page_index);
 
+// Whether the page with the given index is usable by the kernel only.
+unsigned int at_is_kern(unsigned int page_index);
+
 // Whether the page with the given index is already allocated.
 unsigned int at_is_allocated(unsigned int page_index);
 
 // Mark the allocation flag of the page with the given index using the given value.
 void at_set_allocated(unsigned int page_index, unsigned int allocated);
 
+// The first normal and unallocated page in [from, to), or to if there is none.
+unsigned int at_next_free(unsigned int from, unsigned int to);
+
+// The first page in [from, to) that is not normal and unallocated, or to if there is none.
+unsigned int at_next_nonfree(unsigned int from, unsigned int to);
+
+/**
+ * Lower layer initialization function.
+ * It initializes the physical allocation table.
+ */
+void pmem_init(unsigned int mbi_addr);
+
 #endif  /* _KERN_ */
 
 #endif  /* !_KERN_PMM_MATOP_H_ */
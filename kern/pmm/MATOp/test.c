@@ -35,6 +35,75 @@ int MATOp_test1()
     return 0;
 }
 
+int MATOp_test2()
+{
+    int i;
+    int page_index = palloc_order(3);
+    if (page_index == 0 || page_index % 8 != 0) {
+        dprintf("test 2.1 failed: (%d == 0 || %d %% 8 != 0)\n", page_index, page_index);
+        pfree_order(page_index, 3);
+        return 1;
+    }
+    for (i = 0; i < 8; i++) {
+        if (at_is_allocated(page_index + i) != 1) {
+            dprintf("test 2.2 failed (i = %d): (%d != 1)\n", i, at_is_allocated(page_index + i));
+            pfree_order(page_index, 3);
+            return 1;
+        }
+    }
+    pfree_order(page_index, 3);
+    for (i = 0; i < 8; i++) {
+        if (at_is_allocated(page_index + i) != 0) {
+            dprintf("test 2.3 failed (i = %d): (%d != 0)\n", i, at_is_allocated(page_index + i));
+            return 1;
+        }
+    }
+    pfree_order(page_index, 3);
+    if (palloc_order(11) != 0) {
+        dprintf("test 2.4 failed: (palloc_order(11) != 0)\n");
+        return 1;
+    }
+    dprintf("test 2 passed.\n");
+    return 0;
+}
+
+int MATOp_test3()
+{
+    int i;
+    int page_index = palloc_range(5);
+    if (page_index == 0) {
+        dprintf("test 3.1 failed: (%d == 0)\n", page_index);
+        return 1;
+    }
+    for (i = 0; i < 5; i++) {
+        if (at_is_allocated(page_index + i) != 1) {
+            dprintf("test 3.2 failed (i = %d): (%d != 1)\n", i, at_is_allocated(page_index + i));
+            pfree_range(page_index, 5);
+            return 1;
+        }
+    }
+    for (i = 5; i < 8; i++) {
+        if (at_is_allocated(page_index + i) != 0) {
+            dprintf("test 3.3 failed (i = %d): (%d != 0)\n", i, at_is_allocated(page_index + i));
+            pfree_range(page_index, 5);
+            return 1;
+        }
+    }
+    pfree_range(page_index, 5);
+    for (i = 0; i < 5; i++) {
+        if (at_is_allocated(page_index + i) != 0) {
+            dprintf("test 3.4 failed (i = %d): (%d != 0)\n", i, at_is_allocated(page_index + i));
+            return 1;
+        }
+    }
+    if (palloc_range(0) != 0 || palloc_range(1025) != 0) {
+        dprintf("test 3.5 failed: (palloc_range(0) != 0 || palloc_range(1025) != 0)\n");
+        return 1;
+    }
+    dprintf("test 3 passed.\n");
+    return 0;
+}
+
 /**
  * Write Your Own Test Script (optional)
  *
@@ -82,5 +151,5 @@ int MATOp_test_own()
 
 int test_MATOp()
 {
-    return MATOp_test1() + MATOp_test_own();
+    return MATOp_test1() + MATOp_test2() + MATOp_test3() + MATOp_test_own();
 }
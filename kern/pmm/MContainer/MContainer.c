@@ -1,4 +1,6 @@
 #include <lib/debug.h>
+#include <lib/string.h>
+#include <lib/types.h>
 #include <lib/x86.h>
 #include "import.h"
 
@@ -8,10 +10,92 @@ struct SContainer {
     int parent;     // the id of the parent process
     int nchildren;  // the number of child processes
     int used;       // whether current container is used by a process
+    int child;      // the id of the first child, or NUM_CONTAINERS
+    int next;       // the next sibling, or the next free id if not used
+    int prev;       // the previous sibling, or NUM_CONTAINERS
 };
 
-// mCertiKOS supports up to NUM_IDS processes
-static struct SContainer CONTAINER[NUM_IDS];
+/**
+ * Containers are allocated on demand, CONTAINER_CHUNK at a time, with kmalloc.
+ * CONTAINER_DIR holds the chunks, so the container of an id is found in two
+ * steps and only the chunks that were ever used take memory.
+ * The ids are split in two pools: the ids below NUM_IDS, the only ones that
+ * can have a page structure, are reserved for processes (container_split),
+ * and the others go to the containers that only hold quota for their
+ * children (container_split_group), so that the latter never use up the
+ * former. In each pool, ids are handed out in increasing order; the ids of
+ * destroyed containers are kept in a free list (linked through next) and
+ * reused first.
+ */
+#define CONTAINER_CHUNK 64
+#define CONTAINER_NDIR  (NUM_CONTAINERS / CONTAINER_CHUNK)
+
+#define CONTAINER_POOL_PROC  0
+#define CONTAINER_POOL_GROUP 1
+#define CONTAINER_POOL(id)   ((id) < NUM_IDS ? CONTAINER_POOL_PROC : CONTAINER_POOL_GROUP)
+
+static struct SContainer *CONTAINER_DIR[CONTAINER_NDIR];
+static unsigned int CONTAINER_NEXT_ID[2];  // the lowest id of each pool never handed out
+static unsigned int CONTAINER_FREE[2];     // the free list of each pool, NUM_CONTAINERS if empty
+static unsigned int CONTAINER_NUSED;
+
+// The end of the ids of each pool.
+static const unsigned int CONTAINER_POOL_END[2] = {NUM_IDS, NUM_CONTAINERS};
+
+// Returns the container of a valid id.
+#define CONTAINER(id) (CONTAINER_DIR[(id) / CONTAINER_CHUNK][(id) % CONTAINER_CHUNK])
+
+// Whether [id] is the id of a container in use.
+unsigned int container_is_used(unsigned int id)
+{
+    return id < CONTAINER_NEXT_ID[CONTAINER_POOL(id)] && CONTAINER(id).used;
+}
+
+/**
+ * Takes an id of the given pool from its free list, or else the next one never
+ * handed out, allocating its chunk if needed.
+ * Returns NUM_CONTAINERS if all the ids of the pool are in use or memory runs out.
+ */
+static unsigned int container_new_id(unsigned int pool)
+{
+    unsigned int id;
+    struct SContainer *chunk;
+
+    if (CONTAINER_FREE[pool] != NUM_CONTAINERS) {
+        id = CONTAINER_FREE[pool];
+        CONTAINER_FREE[pool] = CONTAINER(id).next;
+        return id;
+    }
+
+    if (CONTAINER_NEXT_ID[pool] == CONTAINER_POOL_END[pool]) {
+        return NUM_CONTAINERS;
+    }
+    id = CONTAINER_NEXT_ID[pool];
+    if (CONTAINER_DIR[id / CONTAINER_CHUNK] == NULL) {
+        chunk = kmalloc(sizeof(struct SContainer) * CONTAINER_CHUNK);
+        if (chunk == NULL) {
+            return NUM_CONTAINERS;
+        }
+        memzero(chunk, sizeof(struct SContainer) * CONTAINER_CHUNK);
+        CONTAINER_DIR[id / CONTAINER_CHUNK] = chunk;
+    }
+    CONTAINER_NEXT_ID[pool]++;
+    return id;
+}
+
+static void container_set(unsigned int id, unsigned int quota,
+                          unsigned int parent)
+{
+    CONTAINER(id).quota = quota;
+    CONTAINER(id).usage = 0;
+    CONTAINER(id).parent = parent;
+    CONTAINER(id).nchildren = 0;
+    CONTAINER(id).used = 1;
+    CONTAINER(id).child = NUM_CONTAINERS;
+    CONTAINER(id).next = NUM_CONTAINERS;
+    CONTAINER(id).prev = NUM_CONTAINERS;
+    CONTAINER_NUSED++;
+}
 
 /**
  * Initializes the container data for the root process (the one with index 0).
@@ -19,58 +103,48 @@ static struct SContainer CONTAINER[NUM_IDS];
  */
 void container_init(unsigned int mbi_addr)
 {
-    unsigned int real_quota, pg_idx, nps;
-    // TODO: define your local variables here.
+    unsigned int real_quota;
 
-    pmem_init(mbi_addr);
-    real_quota = 0;
+    slab_init(mbi_addr);
 
     /**
-     * TODO: Compute the available quota and store it into the variable real_quota.
-     * It should be the number of the unallocated pages with the normal permission
-     * in the physical memory allocation table.
+     * The available quota is the number of the unallocated pages with the
+     * normal permission in the physical memory allocation table, which the
+     * MATIntro layer keeps track of.
      */
-
-    pg_idx = 0;
-    nps = get_nps();
-    while (pg_idx < nps) {
-        if (at_is_norm(pg_idx) && !at_is_allocated(pg_idx)) {
-            real_quota++;
-        }
-        pg_idx++;
-    }
+    real_quota = at_get_nfree();
 
     KERN_DEBUG("\nreal quota: %d\n\n", real_quota);
 
-    CONTAINER[0].quota = real_quota;
-    CONTAINER[0].usage = 0;
-    CONTAINER[0].parent = 0;
-    CONTAINER[0].nchildren = 0;
-    CONTAINER[0].used = 1;
+    CONTAINER_NEXT_ID[CONTAINER_POOL_PROC] = 0;
+    CONTAINER_NEXT_ID[CONTAINER_POOL_GROUP] = NUM_IDS;
+    CONTAINER_FREE[CONTAINER_POOL_PROC] = NUM_CONTAINERS;
+    CONTAINER_FREE[CONTAINER_POOL_GROUP] = NUM_CONTAINERS;
+    container_set(container_new_id(CONTAINER_POOL_PROC), real_quota, 0);
 }
 
 // Get the id of parent process of process # [id].
 unsigned int container_get_parent(unsigned int id)
 {
-    return CONTAINER[id].parent;
+    return CONTAINER(id).parent;
 }
 
 // Get the number of children of process # [id].
 unsigned int container_get_nchildren(unsigned int id)
 {
-    return CONTAINER[id].nchildren;
+    return CONTAINER(id).nchildren;
 }
 
 // Get the maximum memory quota of process # [id].
 unsigned int container_get_quota(unsigned int id)
 {
-    return CONTAINER[id].quota;
+    return CONTAINER(id).quota;
 }
 
 // Get the current memory usage of process # [id].
 unsigned int container_get_usage(unsigned int id)
 {
-    return CONTAINER[id].usage;
+    return CONTAINER(id).usage;
 }
 
 // Determines whether the process # [id] can consume an extra
@@ -80,46 +154,115 @@ unsigned int container_can_consume(unsigned int id, unsigned int n)
     // TODO
     // Do we need to check if there are n pages of pmem available? Or is that
     // Done in another method
-    if (CONTAINER[id].usage + n > CONTAINER[id].quota) {
+    if (CONTAINER(id).usage + n > CONTAINER(id).quota) {
         return 0;
     } else {
         return 1;
     }
 }
 
+// Get the id of the first child of process # [id], or NUM_CONTAINERS if none.
+unsigned int container_get_child(unsigned int id)
+{
+    return CONTAINER(id).child;
+}
+
+// Get the id of the next sibling of process # [id], or NUM_CONTAINERS if none.
+unsigned int container_get_next(unsigned int id)
+{
+    return CONTAINER(id).next;
+}
+
+// The number of containers in use.
+unsigned int container_get_nused(void)
+{
+    return CONTAINER_NUSED;
+}
+
+// Creates a child of container # [id] with [quota] pages, its id taken from [pool].
+static unsigned int container_split_pool(unsigned int id, unsigned int quota,
+                                         unsigned int pool)
+{
+    unsigned int child;
+
+    child = container_new_id(pool);
+    if (child == NUM_CONTAINERS) {
+        return NUM_CONTAINERS;
+    }
+
+    // Update child container
+    container_set(child, quota, id);
+
+    // Update parent container, the child goes first in its list of children
+    CONTAINER(child).next = CONTAINER(id).child;
+    if (CONTAINER(id).child != NUM_CONTAINERS) {
+        CONTAINER(CONTAINER(id).child).prev = child;
+    }
+    CONTAINER(id).child = child;
+    CONTAINER(id).usage += quota;
+    CONTAINER(id).nchildren += 1;
+
+    return child;
+}
+
 /**
  * Dedicates [quota] pages of memory for a new child process.
  * You can assume it is safe to allocate [quota] pages
  * (the check is already done outside before calling this function).
- * Returns the container index for the new child process.
+ * The id is below NUM_IDS, so that the process can get a page structure.
+ * Returns the container index for the new child process,
+ * or NUM_CONTAINERS if there is no process id left.
  */
 unsigned int container_split(unsigned int id, unsigned int quota)
 {
-    unsigned int child, nc;
+    return container_split_pool(id, quota, CONTAINER_POOL_PROC);
+}
 
-    nc = CONTAINER[id].nchildren;
-    child = id * MAX_CHILDREN + 1 + nc;  // container index for the child process
+/**
+ * Same as container_split, for a container that is not a process but only
+ * holds [quota] pages for the containers it is split into (e.g., a tenant).
+ * Its id is NUM_IDS or above, so up to NUM_CONTAINERS - NUM_IDS of them can
+ * exist without taking any process id.
+ * Returns NUM_CONTAINERS if there is no container left.
+ */
+unsigned int container_split_group(unsigned int id, unsigned int quota)
+{
+    return container_split_pool(id, quota, CONTAINER_POOL_GROUP);
+}
 
-    if (NUM_IDS <= child) {
-        return NUM_IDS;
-    }
+/**
+ * Destroys the container of process # [id] and recycles its id.
+ * Its quota is given back to the parent. The process must not have any child
+ * left nor any page charged to it, and the root container cannot be destroyed.
+ * Returns 1 on success, and 0 otherwise.
+ */
+unsigned int container_destroy(unsigned int id)
+{
+    unsigned int parent;
 
-    /**
-     * TODO: Update the container structure of both parent and child process appropriately.
-     */
+    if (id == 0 || !container_is_used(id)
+        || CONTAINER(id).nchildren != 0 || CONTAINER(id).usage != 0) {
+        return 0;
+    }
 
-    // Update child container
-    CONTAINER[child].quota = quota;
-    CONTAINER[child].usage = 0;
-    CONTAINER[child].parent = id;
-    CONTAINER[child].nchildren = 0;
-    CONTAINER[child].used = 1;
+    parent = CONTAINER(id).parent;
+    if (CONTAINER(id).prev != NUM_CONTAINERS) {
+        CONTAINER(CONTAINER(id).prev).next = CONTAINER(id).next;
+    } else {
+        CONTAINER(parent).child = CONTAINER(id).next;
+    }
+    if (CONTAINER(id).next != NUM_CONTAINERS) {
+        CONTAINER(CONTAINER(id).next).prev = CONTAINER(id).prev;
+    }
+    CONTAINER(parent).usage -= CONTAINER(id).quota;
+    CONTAINER(parent).nchildren -= 1;
 
-    // Update parent container
-    CONTAINER[id].usage += quota;
-    CONTAINER[id].nchildren += 1;
+    CONTAINER(id).used = 0;
+    CONTAINER(id).next = CONTAINER_FREE[CONTAINER_POOL(id)];
+    CONTAINER_FREE[CONTAINER_POOL(id)] = id;
+    CONTAINER_NUSED--;
 
-    return child;
+    return 1;
 }
 
 /**
@@ -132,20 +275,107 @@ unsigned int container_alloc(unsigned int id)
     /*
      * TODO: Implement the function here.
      */
-    unsigned int pg_index = palloc();
+    unsigned int pg_index = pcache_alloc();
     if (pg_index == 0) {
         // No phyiscal page found, return 0
         return 0;
     } else {
-        CONTAINER[id].usage += 1;
+        at_set_refcnt(pg_index, 1);
+        CONTAINER(id).usage += 1;
         return pg_index;
     }
 }
 
-// Frees the physical page and reduces the usage by 1.
+/**
+ * Drops the reference of process # [id] to the physical page and reduces
+ * the usage by 1. The page itself is only freed with its last reference.
+ */
 void container_free(unsigned int id, unsigned int page_index)
 {
-    // TODO
-    pfree(page_index);
-    CONTAINER[id].usage -= 1;
+    if (at_dec_refcnt(page_index) == 0) {
+        pcache_free(page_index);
+    }
+    CONTAINER(id).usage -= 1;
+}
+
+/**
+ * Same as container_free for the [n] physical pages in [pages], with a single
+ * usage update. The pages whose last reference is dropped go back to MATOp
+ * together, bypassing the per-CPU magazine that a large batch would only
+ * overflow, e.g., when a whole address space is torn down.
+ * The array is reused to collect those pages, so its content is lost.
+ */
+void container_free_batch(unsigned int id, unsigned int *pages, unsigned int n)
+{
+    unsigned int i, nfree;
+
+    nfree = 0;
+    for (i = 0; i < n; i++) {
+        if (at_dec_refcnt(pages[i]) == 0) {
+            pages[nfree] = pages[i];
+            nfree++;
+        }
+    }
+    pfree_batch(pages, nfree);
+    CONTAINER(id).usage -= n;
+}
+
+/**
+ * Takes one more reference to an allocated physical page on behalf of
+ * process # [id], e.g., to map a page of another process copy-on-write.
+ * Each process sharing a page is charged for it, since it may need its own
+ * copy later. The reference is dropped with container_free.
+ */
+void container_share(unsigned int id, unsigned int page_index)
+{
+    at_inc_refcnt(page_index);
+    CONTAINER(id).usage += 1;
+}
+
+/**
+ * Same as container_alloc, but the page is filled with zeros.
+ * Pages from the pre-zeroed pool of the MATCache layer are used first,
+ * and the usage is only charged when the page is handed out here.
+ */
+unsigned int container_alloc_zeroed(unsigned int id)
+{
+    unsigned int pg_index = pcache_alloc_zeroed();
+    if (pg_index == 0) {
+        return 0;
+    }
+    at_set_refcnt(pg_index, 1);
+    CONTAINER(id).usage += 1;
+    return pg_index;
+}
+
+/**
+ * Allocates [n] physically contiguous pages for process # [id], given that
+ * this will not exceed the quota.
+ * The pages are charged to the container with a single usage update.
+ * Ranges are not meant to be shared: each page keeps a single reference.
+ * Returns the page index of the first page, or 0 in the case of failure.
+ */
+unsigned int container_alloc_range(unsigned int id, unsigned int n)
+{
+    unsigned int pg_index;
+
+    if (!container_can_consume(id, n)) {
+        return 0;
+    }
+
+    pg_index = palloc_range(n);
+    if (pg_index == 0) {
+        return 0;
+    }
+
+    CONTAINER(id).usage += n;
+    return pg_index;
+}
+
+// Frees the [n] physical pages starting at [page_index] and reduces the usage by [n].
+void container_free_range(unsigned int id, unsigned int page_index,
+                          unsigned int n)
+{
+    pfree_range(page_index, n);
+    CONTAINER(id).usage -= n;
 }
@@ -9,9 +9,21 @@ unsigned int container_get_nchildren(unsigned int id);
 unsigned int container_get_quota(unsigned int id);
 unsigned int container_get_usage(unsigned int id);
 unsigned int container_can_consume(unsigned int id, unsigned int n);
+unsigned int container_is_used(unsigned int id);
+unsigned int container_get_child(unsigned int id);
+unsigned int container_get_next(unsigned int id);
+unsigned int container_get_nused(void);
 unsigned int container_split(unsigned int id, unsigned int quota);
+unsigned int container_split_group(unsigned int id, unsigned int quota);
+unsigned int container_destroy(unsigned int id);
 unsigned int container_alloc(unsigned int id);
 void container_free(unsigned int id, unsigned int page_index);
+void container_free_batch(unsigned int id, unsigned int *pages, unsigned int n);
+unsigned int container_alloc_zeroed(unsigned int id);
+void container_share(unsigned int id, unsigned int page_index);
+unsigned int container_alloc_range(unsigned int id, unsigned int n);
+void container_free_range(unsigned int id, unsigned int page_index,
+                          unsigned int n);
 
 #endif  /* _KERN_ */
 
@@ -6,9 +6,18 @@
 unsigned int get_nps(void);
 unsigned int at_is_norm(unsigned int page_index);
 unsigned int at_is_allocated(unsigned int page_index);
-void pmem_init(unsigned int mbi_addr);
-unsigned int palloc(void);
-void pfree(unsigned int pfree_index);
+unsigned int at_get_nfree(void);
+void at_set_refcnt(unsigned int page_index, unsigned int refcnt);
+void at_inc_refcnt(unsigned int page_index);
+unsigned int at_dec_refcnt(unsigned int page_index);
+void slab_init(unsigned int mbi_addr);
+void *kmalloc(unsigned int size);
+unsigned int pcache_alloc(void);
+void pcache_free(unsigned int page_index);
+unsigned int pcache_alloc_zeroed(void);
+unsigned int palloc_range(unsigned int n);
+void pfree_range(unsigned int page_index, unsigned int n);
+void pfree_batch(unsigned int *pages, unsigned int n);
 
 #endif  /* _KERN_ */
 
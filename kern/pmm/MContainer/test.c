@@ -1,4 +1,5 @@
 #include <lib/debug.h>
+#include <lib/x86.h>
 #include "export.h"
 
 int MContainer_test1()
@@ -50,6 +51,91 @@ int MContainer_test2()
     return 0;
 }
 
+int MContainer_test3()
+{
+    unsigned int old_usage = container_get_usage(0);
+    unsigned int pg_index = container_alloc_range(0, 16);
+    if (pg_index == 0 || container_get_usage(0) != old_usage + 16) {
+        dprintf("test 3.1 failed: (%d == 0 || %d != %d)\n",
+                pg_index, container_get_usage(0), old_usage + 16);
+        return 1;
+    }
+    container_free_range(0, pg_index, 16);
+    if (container_get_usage(0) != old_usage) {
+        dprintf("test 3.2 failed: (%d != %d)\n", container_get_usage(0), old_usage);
+        return 1;
+    }
+    if (container_alloc_range(0, container_get_quota(0) + 1) != 0) {
+        dprintf("test 3.3 failed: (quota exceeded but range allocated)\n");
+        return 1;
+    }
+    dprintf("test 3 passed.\n");
+    return 0;
+}
+
+int MContainer_test4()
+{
+    unsigned int old_usage = container_get_usage(0);
+    unsigned int old_nused = container_get_nused();
+    unsigned int parent = container_split(0, 100);
+    unsigned int first = container_split(parent, 10);
+    unsigned int second = container_split(parent, 10);
+    if (container_get_child(parent) != second || container_get_next(second) != first
+        || container_get_next(first) != NUM_CONTAINERS
+        || container_get_nused() != old_nused + 3) {
+        dprintf("test 4.1 failed: (the children are not listed)\n");
+        return 1;
+    }
+    if (container_destroy(parent) != 0) {
+        dprintf("test 4.2 failed: (a container with children is destroyed)\n");
+        return 1;
+    }
+    if (container_destroy(second) != 1 || container_is_used(second)
+        || container_get_child(parent) != first || container_get_usage(parent) != 10) {
+        dprintf("test 4.3 failed: (the container is not destroyed)\n");
+        return 1;
+    }
+    if (container_split(parent, 10) != second) {
+        dprintf("test 4.4 failed: (the id is not reused)\n");
+        return 1;
+    }
+    container_destroy(second);
+    container_destroy(first);
+    container_destroy(parent);
+    if (container_get_usage(0) != old_usage || container_get_nused() != old_nused) {
+        dprintf("test 4.5 failed: (%d != %d || %d != %d)\n",
+                container_get_usage(0), old_usage, container_get_nused(), old_nused);
+        return 1;
+    }
+    dprintf("test 4 passed.\n");
+    return 0;
+}
+
+int MContainer_test5()
+{
+    unsigned int old_usage = container_get_usage(0);
+    unsigned int group = container_split_group(0, 100);
+    unsigned int proc = container_split(group, 10);
+    if (group < NUM_IDS || group == NUM_CONTAINERS || proc >= NUM_IDS
+        || container_get_parent(proc) != group || container_get_usage(group) != 10) {
+        dprintf("test 5.1 failed: (%d, %d)\n", group, proc);
+        return 1;
+    }
+    container_destroy(proc);
+    container_destroy(group);
+    if (container_is_used(group) || container_split_group(0, 100) != group) {
+        dprintf("test 5.2 failed: (the group id is not reused)\n");
+        return 1;
+    }
+    container_destroy(group);
+    if (container_get_usage(0) != old_usage) {
+        dprintf("test 5.3 failed: (%d != %d)\n", container_get_usage(0), old_usage);
+        return 1;
+    }
+    dprintf("test 5 passed.\n");
+    return 0;
+}
+
 /**
  * Write Your Own Test Script (optional)
  *
@@ -72,5 +158,6 @@ int MContainer_test_own()
 
 int test_MContainer()
 {
-    return MContainer_test1() + MContainer_test2() + MContainer_test_own();
+    return MContainer_test1() + MContainer_test2() + MContainer_test3() + MContainer_test4()
+           + MContainer_test5() + MContainer_test_own();
 }
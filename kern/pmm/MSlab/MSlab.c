@@ -0,0 +1,408 @@
+#include <lib/debug.h>
+#include <lib/string.h>
+#include <lib/types.h>
+#include <lib/x86.h>
+#include "import.h"
+
+/**
+ * A slab allocator for small kernel objects.
+ *
+ * A cache hands out objects of one fixed size. Its objects are carved out of
+ * slabs, each slab being a single kernel page (see kpalloc), which is
+ * identity mapped in every page structure. The page starts with a slab header,
+ * followed by as many objects as fit in the rest of the page.
+ *
+ * Caches are identified by their index in SLAB_CACHE. The first SLAB_NCLASSES
+ * caches are the size classes behind kmalloc and kfree.
+ */
+#define SLAB_NCACHES  32
+#define SLAB_NCLASSES 9     // 8, 16, 32, ..., 2048 bytes
+#define SLAB_MIN_SIZE 8
+#define SLAB_MAX_SIZE 2048
+#define SLAB_ALIGN    8
+
+// The header at the beginning of every slab page.
+struct SSlab {
+    unsigned int cache;     // the index of the owning cache
+    unsigned int ninuse;    // the number of allocated objects
+    void *free;             // list of free objects in this slab
+    struct SSlab *prev;
+    struct SSlab *next;
+};
+
+#define SLAB_HDR_SIZE ROUNDUP(sizeof(struct SSlab), SLAB_ALIGN)
+
+struct SSlabCache {
+    const char *name;
+    unsigned int size;      // the object size asked for by the user
+    unsigned int stride;    // the distance between two objects in a slab
+    unsigned int link;      // offset of the free list link in a free object
+    unsigned int nobjs;     // the number of objects per slab
+    void (*ctor)(void *);   // called once on each object of a new slab
+    struct SSlab *partial;  // slabs with both free and allocated objects
+    struct SSlab *full;     // slabs with no free object
+    struct SSlab *empty;    // at most one slab with no allocated object
+    unsigned int used;      // whether this cache has been created
+
+    // statistics
+    unsigned int nslabs;    // the number of pages held by the cache
+    unsigned int nactive;   // the number of allocated objects
+    unsigned int nallocs;   // the number of successful slab_alloc calls
+    unsigned int nfrees;    // the number of slab_free calls
+};
+
+static struct SSlabCache SLAB_CACHE[SLAB_NCACHES];
+
+static const char *SLAB_CLASS_NAME[SLAB_NCLASSES] = {
+    "kmalloc-8", "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128",
+    "kmalloc-256", "kmalloc-512", "kmalloc-1024", "kmalloc-2048"
+};
+
+static void **slab_link(struct SSlabCache *cache, void *obj)
+{
+    return (void **) ((uintptr_t) obj + cache->link);
+}
+
+static void slab_push(struct SSlab **list, struct SSlab *slab)
+{
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list != NULL) {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+static void slab_remove(struct SSlab **list, struct SSlab *slab)
+{
+    if (slab->prev != NULL) {
+        slab->prev->next = slab->next;
+    } else {
+        *list = slab->next;
+    }
+    if (slab->next != NULL) {
+        slab->next->prev = slab->prev;
+    }
+}
+
+/**
+ * Allocates a new slab page for the cache, links all of its objects into the
+ * slab's free list and runs the constructor on them.
+ * Returns NULL if there is no free physical page left.
+ */
+static struct SSlab *slab_grow(unsigned int cache_id)
+{
+    struct SSlabCache *cache = &SLAB_CACHE[cache_id];
+    struct SSlab *slab;
+    unsigned int page_index, i;
+    uintptr_t obj;
+
+    page_index = kpalloc();
+    if (page_index == 0) {
+        return NULL;
+    }
+
+    slab = (struct SSlab *) (page_index * PAGESIZE);
+    slab->cache = cache_id;
+    slab->ninuse = 0;
+    slab->free = NULL;
+
+    // link the objects in reverse, so that they are handed out in address order
+    i = cache->nobjs;
+    while (i > 0) {
+        i--;
+        obj = (uintptr_t) slab + SLAB_HDR_SIZE + i * cache->stride;
+        if (cache->ctor != NULL) {
+            cache->ctor((void *) obj);
+        }
+        *slab_link(cache, (void *) obj) = slab->free;
+        slab->free = (void *) obj;
+    }
+
+    cache->nslabs++;
+#ifdef DEBUG_SLAB
+    KERN_DEBUG("slab: %s grows to %d slabs.\n", cache->name, cache->nslabs);
+#endif
+
+    return slab;
+}
+
+// Returns the page of a slab with no allocated object to MATOp.
+static void slab_release(struct SSlabCache *cache, struct SSlab *slab)
+{
+    cache->nslabs--;
+#ifdef DEBUG_SLAB
+    KERN_DEBUG("slab: %s shrinks to %d slabs.\n", cache->name, cache->nslabs);
+#endif
+    kpfree((uintptr_t) slab / PAGESIZE);
+}
+
+#ifdef DEBUG_SLAB
+/**
+ * Panics if obj cannot be an allocated object of its slab: the page must
+ * belong to a live cache, obj must be at an object boundary, and it must not
+ * be on the slab's free list already.
+ */
+static void slab_check_free(struct SSlab *slab, void *obj)
+{
+    struct SSlabCache *cache;
+    uintptr_t offset;
+    void *free;
+
+    if (slab->cache >= SLAB_NCACHES || !SLAB_CACHE[slab->cache].used) {
+        KERN_PANIC("slab: freeing 0x%08x, which is not in a slab.\n", obj);
+    }
+    cache = &SLAB_CACHE[slab->cache];
+
+    offset = (uintptr_t) obj - (uintptr_t) slab;
+    if (offset < SLAB_HDR_SIZE || (offset - SLAB_HDR_SIZE) % cache->stride != 0
+        || (offset - SLAB_HDR_SIZE) / cache->stride >= cache->nobjs) {
+        KERN_PANIC("slab: freeing 0x%08x, which is not an object of %s.\n",
+                   obj, cache->name);
+    }
+
+    for (free = slab->free; free != NULL; free = *slab_link(cache, free)) {
+        if (free == obj) {
+            KERN_PANIC("slab: double free of 0x%08x in %s.\n", obj, cache->name);
+        }
+    }
+}
+#endif
+
+/**
+ * Creates a cache of objects of the given size, which must be at most
+ * SLAB_MAX_SIZE bytes.
+ * If ctor is not NULL, it is called on every object when its slab is
+ * allocated, not on every slab_alloc. Objects must therefore be returned to
+ * the cache in their constructed state, and the free list link is then kept
+ * after the object so that it does not clobber the constructed fields.
+ * Returns the index of the new cache, or SLAB_NCACHES in the case of failure.
+ */
+unsigned int slab_cache_create(const char *name, unsigned int size,
+                               void (*ctor)(void *))
+{
+    struct SSlabCache *cache;
+    unsigned int cache_id;
+
+    if (size == 0 || size > SLAB_MAX_SIZE) {
+        return SLAB_NCACHES;
+    }
+
+    for (cache_id = 0; cache_id < SLAB_NCACHES; cache_id++) {
+        if (!SLAB_CACHE[cache_id].used) {
+            break;
+        }
+    }
+    if (cache_id == SLAB_NCACHES) {
+        return SLAB_NCACHES;
+    }
+
+    cache = &SLAB_CACHE[cache_id];
+    memzero(cache, sizeof(struct SSlabCache));
+    cache->name = name;
+    cache->size = size;
+    if (ctor != NULL) {
+        cache->link = ROUNDUP(size, sizeof(void *));
+        cache->stride = ROUNDUP(cache->link + sizeof(void *), SLAB_ALIGN);
+    } else {
+        cache->link = 0;
+        cache->stride = ROUNDUP(size, SLAB_ALIGN);
+    }
+    cache->nobjs = (PAGESIZE - SLAB_HDR_SIZE) / cache->stride;
+    cache->ctor = ctor;
+    cache->used = 1;
+
+    return cache_id;
+}
+
+/**
+ * Destroys a cache, returning its slabs to the page cache.
+ * All of its objects must have been freed.
+ */
+void slab_cache_destroy(unsigned int cache_id)
+{
+    struct SSlabCache *cache = &SLAB_CACHE[cache_id];
+
+    KERN_ASSERT(cache->used && cache->nactive == 0);
+
+    if (cache->empty != NULL) {
+        slab_release(cache, cache->empty);
+        cache->empty = NULL;
+    }
+    cache->used = 0;
+}
+
+/**
+ * Allocates an object from the cache.
+ * Partially used slabs are used first, then the cached empty slab,
+ * and a new slab is only allocated when neither exists.
+ * Returns NULL if there is no free physical page left.
+ */
+void *slab_alloc(unsigned int cache_id)
+{
+    struct SSlabCache *cache = &SLAB_CACHE[cache_id];
+    struct SSlab *slab;
+    void *obj;
+
+    slab = cache->partial;
+    if (slab == NULL) {
+        if (cache->empty != NULL) {
+            slab = cache->empty;
+            cache->empty = NULL;
+        } else {
+            slab = slab_grow(cache_id);
+            if (slab == NULL) {
+                return NULL;
+            }
+        }
+        slab_push(&cache->partial, slab);
+    }
+
+    obj = slab->free;
+    slab->free = *slab_link(cache, obj);
+    slab->ninuse++;
+    if (slab->free == NULL) {
+        slab_remove(&cache->partial, slab);
+        slab_push(&cache->full, slab);
+    }
+
+    cache->nactive++;
+    cache->nallocs++;
+    return obj;
+}
+
+/**
+ * Frees an object allocated with slab_alloc or kmalloc.
+ * The owning cache is found through the header of the object's page.
+ * A slab that becomes empty is kept as the cache's empty slab if there is
+ * none yet, otherwise its page goes back to the page cache.
+ */
+void slab_free(void *obj)
+{
+    struct SSlabCache *cache;
+    struct SSlab *slab;
+
+    if (obj == NULL) {
+        return;
+    }
+
+    slab = (struct SSlab *) ROUNDDOWN((uintptr_t) obj, PAGESIZE);
+#ifdef DEBUG_SLAB
+    slab_check_free(slab, obj);
+#endif
+    cache = &SLAB_CACHE[slab->cache];
+
+    if (slab->free == NULL) {
+        slab_remove(&cache->full, slab);
+        slab_push(&cache->partial, slab);
+    }
+    *slab_link(cache, obj) = slab->free;
+    slab->free = obj;
+    slab->ninuse--;
+
+    if (slab->ninuse == 0) {
+        slab_remove(&cache->partial, slab);
+        if (cache->empty == NULL) {
+            cache->empty = slab;
+        } else {
+            slab_release(cache, slab);
+        }
+    }
+
+    cache->nactive--;
+    cache->nfrees++;
+}
+
+/**
+ * Allocates size bytes from the smallest size class that can hold them.
+ * Returns NULL if size is 0 or larger than SLAB_MAX_SIZE,
+ * or if there is no free physical page left.
+ */
+void *kmalloc(unsigned int size)
+{
+    unsigned int class, class_size;
+
+    if (size == 0 || size > SLAB_MAX_SIZE) {
+        return NULL;
+    }
+
+    class = 0;
+    class_size = SLAB_MIN_SIZE;
+    while (class_size < size) {
+        class++;
+        class_size <<= 1;
+    }
+
+    return slab_alloc(class);
+}
+
+// Frees memory allocated with kmalloc.
+void kfree(void *ptr)
+{
+    slab_free(ptr);
+}
+
+/**
+ * Initializes the page allocator (with palloc_init),
+ * then creates the size classes used by kmalloc.
+ */
+void slab_init(unsigned int mbi_addr)
+{
+    unsigned int class, cache_id;
+
+    palloc_init(mbi_addr);
+
+    for (class = 0; class < SLAB_NCLASSES; class++) {
+        cache_id = slab_cache_create(SLAB_CLASS_NAME[class],
+                                     SLAB_MIN_SIZE << class, NULL);
+        KERN_ASSERT(cache_id == class);
+    }
+}
+
+// The maximum number of caches.
+unsigned int slab_get_ncaches(void)
+{
+    return SLAB_NCACHES;
+}
+
+// Whether the cache # [cache_id] has been created.
+unsigned int slab_is_used(unsigned int cache_id)
+{
+    return cache_id < SLAB_NCACHES && SLAB_CACHE[cache_id].used;
+}
+
+// The name of the cache # [cache_id].
+const char *slab_get_name(unsigned int cache_id)
+{
+    return SLAB_CACHE[cache_id].name;
+}
+
+// The object size of the cache # [cache_id].
+unsigned int slab_get_size(unsigned int cache_id)
+{
+    return SLAB_CACHE[cache_id].size;
+}
+
+// The number of pages held by the cache # [cache_id].
+unsigned int slab_get_nslabs(unsigned int cache_id)
+{
+    return SLAB_CACHE[cache_id].nslabs;
+}
+
+// The number of allocated objects of the cache # [cache_id].
+unsigned int slab_get_nactive(unsigned int cache_id)
+{
+    return SLAB_CACHE[cache_id].nactive;
+}
+
+// The number of allocations served by the cache # [cache_id].
+unsigned int slab_get_nallocs(unsigned int cache_id)
+{
+    return SLAB_CACHE[cache_id].nallocs;
+}
+
+// The number of frees received by the cache # [cache_id].
+unsigned int slab_get_nfrees(unsigned int cache_id)
+{
+    return SLAB_CACHE[cache_id].nfrees;
+}
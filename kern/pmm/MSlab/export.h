@@ -0,0 +1,25 @@
+#ifndef _KERN_PMM_MSLAB_H_
+#define _KERN_PMM_MSLAB_H_
+
+#ifdef _KERN_
+
+void slab_init(unsigned int mbi_addr);
+unsigned int slab_cache_create(const char *name, unsigned int size,
+                               void (*ctor)(void *));
+void slab_cache_destroy(unsigned int cache_id);
+void *slab_alloc(unsigned int cache_id);
+void slab_free(void *obj);
+void *kmalloc(unsigned int size);
+void kfree(void *ptr);
+unsigned int slab_get_ncaches(void);
+unsigned int slab_is_used(unsigned int cache_id);
+const char *slab_get_name(unsigned int cache_id);
+unsigned int slab_get_size(unsigned int cache_id);
+unsigned int slab_get_nslabs(unsigned int cache_id);
+unsigned int slab_get_nactive(unsigned int cache_id);
+unsigned int slab_get_nallocs(unsigned int cache_id);
+unsigned int slab_get_nfrees(unsigned int cache_id);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_PMM_MSLAB_H_ */
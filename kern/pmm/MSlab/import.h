@@ -0,0 +1,13 @@
+#ifndef _KERN_PMM_MSLAB_H_
+#define _KERN_PMM_MSLAB_H_
+
+#ifdef _KERN_
+
+// Page allocation functions implemented in the MATOp layer.
+void palloc_init(unsigned int mbi_addr);
+unsigned int kpalloc(void);
+void kpfree(unsigned int page_index);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_PMM_MSLAB_H_ */
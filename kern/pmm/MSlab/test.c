@@ -0,0 +1,99 @@
+#include <lib/debug.h>
+#include <lib/types.h>
+#include <pmm/MATIntro/export.h>
+#include "export.h"
+
+static unsigned int MSlab_ctor_calls;
+
+static void MSlab_test_ctor(void *obj)
+{
+    *(unsigned int *) obj = 0xdeadbeef;
+    MSlab_ctor_calls++;
+}
+
+int MSlab_test1()
+{
+    unsigned int i, nslabs;
+    void *objs[600];
+
+    // the first size class holds 8 byte objects
+    nslabs = slab_get_nslabs(0);
+    for (i = 0; i < 600; i++) {
+        objs[i] = kmalloc(5);
+        if (objs[i] == NULL) {
+            dprintf("test 1.1 failed (i = %d): (kmalloc(5) == NULL)\n", i);
+            for (; i > 0; i--) {
+                kfree(objs[i - 1]);
+            }
+            return 1;
+        }
+    }
+    if (slab_get_nslabs(0) <= nslabs) {
+        dprintf("test 1.2 failed: (%d <= %d)\n", slab_get_nslabs(0), nslabs);
+        return 1;
+    }
+    if (objs[1] == objs[0] || at_is_allocated((uintptr_t) objs[0] / 4096) != 1) {
+        dprintf("test 1.3 failed: (objects are not distinct allocated memory)\n");
+        return 1;
+    }
+    if (!at_is_kern((uintptr_t) objs[0] / 4096)) {
+        dprintf("test 1.4 failed: (objects are not in kernel pages)\n");
+        return 1;
+    }
+    for (i = 0; i < 600; i++) {
+        kfree(objs[i]);
+    }
+    if (slab_get_nslabs(0) > nslabs + 1) {
+        dprintf("test 1.5 failed: (%d > %d)\n", slab_get_nslabs(0), nslabs + 1);
+        return 1;
+    }
+    if (kmalloc(0) != NULL || kmalloc(2049) != NULL) {
+        dprintf("test 1.6 failed: (kmalloc(0) != NULL || kmalloc(2049) != NULL)\n");
+        return 1;
+    }
+    dprintf("test 1 passed.\n");
+    return 0;
+}
+
+int MSlab_test2()
+{
+    unsigned int cache_id, nactive;
+    unsigned int *obj;
+
+    MSlab_ctor_calls = 0;
+    cache_id = slab_cache_create("test", 12, MSlab_test_ctor);
+    if (!slab_is_used(cache_id)) {
+        dprintf("test 2.1 failed: (cache %d is not created)\n", cache_id);
+        return 1;
+    }
+    obj = slab_alloc(cache_id);
+    if (obj == NULL || *obj != 0xdeadbeef || MSlab_ctor_calls == 0) {
+        dprintf("test 2.2 failed: (the object is not constructed)\n");
+        slab_free(obj);
+        slab_cache_destroy(cache_id);
+        return 1;
+    }
+    nactive = slab_get_nactive(cache_id);
+    slab_free(obj);
+    if (slab_get_nactive(cache_id) != nactive - 1
+        || slab_get_nallocs(cache_id) != 1 || slab_get_nfrees(cache_id) != 1) {
+        dprintf("test 2.3 failed: (%d != %d || %d != 1 || %d != 1)\n",
+                slab_get_nactive(cache_id), nactive - 1,
+                slab_get_nallocs(cache_id), slab_get_nfrees(cache_id));
+        slab_cache_destroy(cache_id);
+        return 1;
+    }
+    if (*obj != 0xdeadbeef) {
+        dprintf("test 2.4 failed: (a freed object lost its constructed state)\n");
+        slab_cache_destroy(cache_id);
+        return 1;
+    }
+    slab_cache_destroy(cache_id);
+    dprintf("test 2 passed.\n");
+    return 0;
+}
+
+int test_MSlab()
+{
+    return MSlab_test1() + MSlab_test2();
+}
@@ -1,38 +1,107 @@
+#include <lib/debug.h>
 #include <lib/x86.h>
 
 #include "import.h"
 
+#define VM_USERLO     0x40000000
+#define VM_USERHI     0xF0000000
+#define VM_USERLO_PDE (VM_USERLO / (PAGESIZE * 1024))
+#define VM_USERHI_PDE (VM_USERHI / (PAGESIZE * 1024))
+
 /**
- * For each process from id 0 to NUM_IDS - 1,
- * set up the page directory entries so that the kernel portion of the map is
- * the identity map, and the rest of the page directories are unmapped.
+ * Sets up the identity page tables, and the page directory of process 0,
+ * whose kernel portion of the map is the identity map and the rest of which
+ * is unmapped.
+ * The page directories of the other processes are allocated the same way
+ * when the processes are created (see pdir_alloc).
  */
 void pdir_init(unsigned int mbi_addr)
 {
-    // TODO: Define your local variables here.
-
     idptbl_init(mbi_addr);
 
-    // TODO
+    if (pdir_alloc(0) == 0) {
+        KERN_PANIC("No page for the page directory of process 0.\n");
+    }
 }
 
 /**
- * Allocates a page (with container_alloc) for the page table,
- * and registers it in the page directory for the given virtual address,
- * and clears (set to 0) all page table entries for this newly mapped page table.
+ * Allocates a page (with container_alloc_zeroed) for the page table,
+ * (as well as the page directory if the process does not have one yet),
+ * and registers it in the page directory for the given virtual address.
+ * All page table entries of the newly mapped page table are cleared (set to 0),
+ * since the page comes zeroed.
  * It returns the page index of the newly allocated physical page.
  * In the case when there's no physical page available, it returns 0.
  */
 unsigned int alloc_ptbl(unsigned int proc_index, unsigned int vaddr)
 {
-    // TODO
-    return 0;
+    unsigned int page_index;
+
+    if (pdir_alloc(proc_index) == 0) {
+        return 0;
+    }
+
+    // the page comes zeroed, i.e., with all its entries cleared
+    page_index = container_alloc_zeroed(proc_index);
+    if (page_index == 0) {
+        return 0;
+    }
+
+    set_pdir_entry_by_va(proc_index, vaddr, page_index);
+
+    return page_index;
 }
 
 // Reverse operation of alloc_ptbl.
 // Removes corresponding the page directory entry,
 // and frees the page for the page table entries (with container_free).
+// Nothing is done if the page directory entry does not point to a page table,
+// e.g., for a 4MB mapping.
 void free_ptbl(unsigned int proc_index, unsigned int vaddr)
 {
-    // TODO
+    unsigned int pde;
+
+    pde = get_pdir_entry_by_va(proc_index, vaddr);
+    if ((pde & PTE_P) == 0 || (pde & PTE_PS)) {
+        return;
+    }
+
+    rmv_pdir_entry_by_va(proc_index, vaddr);
+    container_free(proc_index, pde / PAGESIZE);
+}
+
+// Frees the page table of [vaddr] (with free_ptbl) if none of its entries is used.
+void free_ptbl_if_empty(unsigned int proc_index, unsigned int vaddr)
+{
+    unsigned int pde;
+
+    pde = get_pdir_entry_by_va(proc_index, vaddr);
+    if ((pde & PTE_P) && !(pde & PTE_PS)
+        && get_ptbl_nlive(proc_index, vaddr / (PAGESIZE * 1024)) == 0) {
+        free_ptbl(proc_index, vaddr);
+    }
+}
+
+/**
+ * Frees all the page tables of the user portion of the page structure of
+ * process # [proc_index] in a single walk of its page directory, whether they
+ * are empty or not, e.g., when the whole address space is torn down.
+ * The pages they map are not freed.
+ * Returns the number of page tables freed.
+ */
+unsigned int free_all_ptbl(unsigned int proc_index)
+{
+    unsigned int pde_index, pde, nfreed;
+
+    nfreed = 0;
+    for (pde_index = VM_USERLO_PDE; pde_index < VM_USERHI_PDE; pde_index++) {
+        pde = get_pdir_entry(proc_index, pde_index);
+        if ((pde & PTE_P) == 0 || (pde & PTE_PS)) {
+            continue;
+        }
+        rmv_pdir_entry(proc_index, pde_index);
+        container_free(proc_index, pde / PAGESIZE);
+        nfreed++;
+    }
+    return nfreed;
 }
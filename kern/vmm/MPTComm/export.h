@@ -6,6 +6,8 @@
 void pdir_init(unsigned int mbi_addr);
 unsigned int alloc_ptbl(unsigned int proc_index, unsigned int vaddr);
 void free_ptbl(unsigned int proc_index, unsigned int vaddr);
+void free_ptbl_if_empty(unsigned int proc_index, unsigned int vaddr);
+unsigned int free_all_ptbl(unsigned int proc_index);
 
 #endif  /* _KERN_ */
 
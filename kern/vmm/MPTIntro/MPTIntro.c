@@ -1,27 +1,35 @@
 #include <lib/gcc.h>
 #include <lib/x86.h>
 #include <lib/debug.h>
+#include <lib/kmap.h>
+#include <lib/types.h>
 
 #include "import.h"
 
 #define PT_PERM_UP  0
 #define PT_PERM_PTU (PTE_P | PTE_W | PTE_U)
 
+#define VM_USERLO     0x40000000
+#define VM_USERHI     0xF0000000
+#define VM_USERLO_PDE (VM_USERLO / (PAGESIZE * 1024))
+#define VM_USERHI_PDE (VM_USERHI / (PAGESIZE * 1024))
+
 /**
  * Page directory pool for NUM_IDS processes.
  * mCertiKOS maintains one page structure for each process.
- * Each PDirPool[index] represents the page directory of the page structure
- * for the process # [index].
- * In mCertiKOS, we statically allocate page directories, and maintain the second
- * level page tables dynamically.
- * The unsigned int * type is meant to suggest that the contents of the array
- * are pointers to page tables. In reality they are actually page directory
- * entries, which are essentially pointers plus permission bits. The functions
- * in this layer will require casting between integers and pointers anyway and
- * in fact any 32-bit type is fine, so feel free to change it if it makes more
- * sense to you with a different type.
+ * Each PDirPool[index] points to the page directory of the page structure
+ * for the process # [index], or is NULL if the process has none yet.
+ * Page directories are allocated on demand (see pdir_alloc), one physical
+ * page each, like the second level page tables. PDirPool holds their
+ * physical addresses.
+ * The unsigned int * type is meant to suggest that the contents of a
+ * directory are pointers to page tables. In reality they are actually page
+ * directory entries, which are essentially pointers plus permission bits.
+ * The functions in this layer will require casting between integers and
+ * pointers anyway and in fact any 32-bit type is fine, so feel free to change
+ * it if it makes more sense to you with a different type.
  */
-unsigned int *PDirPool[NUM_IDS][1024] gcc_aligned(PAGESIZE);
+unsigned int **PDirPool[NUM_IDS];
 
 /**
  * In mCertiKOS, we use identity page table mappings for the kernel memory.
@@ -29,21 +37,233 @@ unsigned int *PDirPool[NUM_IDS][1024] gcc_aligned(PAGESIZE);
  * reused for all the kernel memory.
  * That is, in every page directory, the entries that fall into the range of
  * addresses reserved for the kernel will point to an entry in IDPTbl.
+ * Their page table entries are global (PTE_G) and supervisor-only, so the
+ * kernel runs in the page structure of any process, and its mappings stay in
+ * the TLB when CR3 is loaded.
  */
 unsigned int IDPTbl[1024][1024] gcc_aligned(PAGESIZE);
 
-// Sets the CR3 register with the start address of the page structure for process # [index].
+/**
+ * The page directory each CPU has loaded in CR3, or NULL before the first
+ * load. Loading CR3 flushes all the non-global TLB entries even when its value
+ * does not change, so set_pdir_base skips the load in that case.
+ * PDIR_NLOADS and PDIR_NSKIPPED count the loads done and avoided.
+ */
+static unsigned int **PDIR_LOADED[NUM_CPUS];
+static unsigned int PDIR_NLOADS;
+static unsigned int PDIR_NSKIPPED;
+
+/**
+ * The number of pages above which tlb_invalidate flushes the whole TLB by
+ * reloading CR3, rather than invalidating the pages one by one with invlpg.
+ * The kernel identity mappings are global (PTE_G), so they survive both.
+ */
+#define TLB_INVLPG_MAX 32
+
+static unsigned int TLB_NINVLPG;
+static unsigned int TLB_NFLUSHES;
+
+/**
+ * The number of nonzero entries (present, or not present but holding
+ * information like PTE_ZSWAP) in the page table of each page directory entry.
+ * It is reset when a page table is registered in or removed from the page
+ * directory, and maintained by set_ptbl_entry and rmv_ptbl_entry, so that a
+ * page table can be freed as soon as it becomes empty.
+ */
+static unsigned short PTBL_NLIVE[NUM_IDS][1024];
+
+/**
+ * The last entry of every page directory (PDIR_SELF) points to the page
+ * directory itself, as a supervisor-only page table. In the active page
+ * structure, this makes the page table of entry # i visible at
+ * VM_SELF_PTBL(i), and the page directory at VM_SELF_PDIR, whatever physical
+ * pages hold them.
+ * The functions below go through this window for the process whose page
+ * structure is loaded on this CPU, and through the kernel window (see kmap)
+ * otherwise, so they work whatever page structure is loaded. The identity map
+ * of the last 8MB of the address space is given up for the two windows;
+ * nothing is there but the BIOS ROM.
+ */
+#define PDIR_SELF         1023
+#define VM_SELF           0xFFC00000
+#define VM_SELF_PTBL(i)   ((unsigned int *) (VM_SELF + (i) * PAGESIZE))
+#define VM_SELF_PDIR      ((unsigned int **) VM_SELF_PTBL(PDIR_SELF))
+
+// Whether the page structure of process # [proc_index] is the one in use.
+// It reads CR3, which is what this CPU walks, rather than PDIR_LOADED.
+unsigned int pdir_is_active(unsigned int proc_index)
+{
+    return PDirPool[proc_index] != NULL
+           && (rcr3() & 0xfffff000) == (unsigned int) PDirPool[proc_index]
+           && (rcr0() & CR0_PG);
+}
+
+// The page directory of process # [proc_index], as the kernel can reach it.
+static unsigned int **pdir_of(unsigned int proc_index)
+{
+    if (pdir_is_active(proc_index)) {
+        return VM_SELF_PDIR;
+    }
+    return kmap(KMAP_PDIR, (unsigned int) PDirPool[proc_index] / PAGESIZE);
+}
+
+// Sets an entry of the page directory of process # [proc_index].
+static void pdir_write(unsigned int proc_index, unsigned int pde_index,
+                       unsigned int pde)
+{
+    unsigned int **pdir = pdir_of(proc_index);
+
+    pdir[pde_index] = (unsigned int *) pde;
+    if (pdir == VM_SELF_PDIR) {
+        // the window onto the page table of the entry moved
+        invlpg((unsigned int) VM_SELF_PTBL(pde_index));
+    }
+}
+
+// The page table of entry # [pde_index] of process # [proc_index],
+// as the kernel can reach it. The entry must map a page table.
+static unsigned int *ptbl_of(unsigned int proc_index, unsigned int pde_index)
+{
+    if (pdir_is_active(proc_index)) {
+        return VM_SELF_PTBL(pde_index);
+    }
+    return kmap(KMAP_PTBL, (unsigned int) pdir_of(proc_index)[pde_index] / PAGESIZE);
+}
+
+/**
+ * Allocates the page directory of process # [proc_index] (with
+ * container_alloc) if it does not have one yet. The kernel portion of the
+ * directory points to the shared identity page tables in IDPTbl, except for
+ * the entry PDIR_SELF that points to the directory itself and the entry
+ * KMAP_PDE that points to the kernel window, and the rest of it is unmapped.
+ * Returns the page index of the page directory, or 0 if there is no physical
+ * page available.
+ */
+unsigned int pdir_alloc(unsigned int proc_index)
+{
+    unsigned int page_index, pde_index;
+    unsigned int **pdir;
+
+    if (PDirPool[proc_index] != NULL) {
+        return (unsigned int) PDirPool[proc_index] / PAGESIZE;
+    }
+
+    page_index = container_alloc(proc_index);
+    if (page_index == 0) {
+        return 0;
+    }
+
+    pdir = kmap(KMAP_PDIR, page_index);
+    for (pde_index = 0; pde_index < 1024; pde_index++) {
+        if (pde_index < VM_USERLO_PDE || VM_USERHI_PDE <= pde_index) {
+            pdir[pde_index] =
+                (unsigned int *) ((unsigned int) IDPTbl[pde_index] | PT_PERM_PTU);
+        } else {
+            pdir[pde_index] = (unsigned int *) PT_PERM_UP;
+        }
+    }
+    pdir[KMAP_PDE] = (unsigned int *) (kmap_ptbl() | PTE_P | PTE_W);
+    pdir[PDIR_SELF] = (unsigned int *) (page_index * PAGESIZE | PTE_P | PTE_W);
+    PDirPool[proc_index] = (unsigned int **) (page_index * PAGESIZE);
+
+    return page_index;
+}
+
+// Reverse operation of pdir_alloc.
+// Frees the page directory of process # [proc_index] (with container_free).
+// Its page tables are not freed; they should be released first.
+void pdir_free(unsigned int proc_index)
+{
+    unsigned int cpu_idx;
+
+    if (PDirPool[proc_index] == NULL) {
+        return;
+    }
+    for (cpu_idx = 0; cpu_idx < NUM_CPUS; cpu_idx++) {
+        if (PDIR_LOADED[cpu_idx] == PDirPool[proc_index]) {
+            PDIR_LOADED[cpu_idx] = NULL;
+        }
+    }
+    container_free(proc_index, (unsigned int) PDirPool[proc_index] / PAGESIZE);
+    PDirPool[proc_index] = NULL;
+}
+
+// Sets the CR3 register with the start address of the page structure for process # [index],
+// unless it is already the one loaded on this CPU.
 void set_pdir_base(unsigned int index)
 {
-    // TODO
+    unsigned int cpu_idx = get_pcpu_idx();
+
+    KERN_ASSERT(PDirPool[index] != NULL);
+    if (PDIR_LOADED[cpu_idx] == PDirPool[index]) {
+        PDIR_NSKIPPED++;
+        return;
+    }
+    set_cr3(PDirPool[index]);
+    PDIR_LOADED[cpu_idx] = PDirPool[index];
+    PDIR_NLOADS++;
+}
+
+/**
+ * Invalidates the TLB entries of the [npages] pages starting at [vaddr] in the
+ * page structure of process # [proc_index], after their mappings changed.
+ * Nothing is done unless the page structure is the one loaded on this CPU;
+ * the others are flushed when they get loaded.
+ */
+void tlb_invalidate(unsigned int proc_index, unsigned int vaddr,
+                    unsigned int npages)
+{
+    unsigned int i;
+
+    if (PDirPool[proc_index] == NULL
+        || PDIR_LOADED[get_pcpu_idx()] != PDirPool[proc_index]) {
+        return;
+    }
+
+    if (npages > TLB_INVLPG_MAX) {
+        set_cr3(PDirPool[proc_index]);
+        TLB_NFLUSHES++;
+        return;
+    }
+    for (i = 0; i < npages; i++) {
+        invlpg(vaddr + i * PAGESIZE);
+    }
+    TLB_NINVLPG += npages;
+}
+
+// The number of pages invalidated with invlpg by tlb_invalidate.
+unsigned int tlb_get_ninvlpg(void)
+{
+    return TLB_NINVLPG;
+}
+
+// The number of full TLB flushes done by tlb_invalidate.
+unsigned int tlb_get_nflushes(void)
+{
+    return TLB_NFLUSHES;
+}
+
+// The number of CR3 loads done by set_pdir_base.
+unsigned int pdir_get_nloads(void)
+{
+    return PDIR_NLOADS;
+}
+
+// The number of CR3 loads set_pdir_base skipped.
+unsigned int pdir_get_nskipped(void)
+{
+    return PDIR_NSKIPPED;
 }
 
 // Returns the page directory entry # [pde_index] of the process # [proc_index].
 // This can be used to test whether the page directory entry is mapped.
+// It is 0 if the process does not have a page directory.
 unsigned int get_pdir_entry(unsigned int proc_index, unsigned int pde_index)
 {
-    // TODO
-    return 0;
+    if (PDirPool[proc_index] == NULL) {
+        return 0;
+    }
+    return (unsigned int) pdir_of(proc_index)[pde_index];
 }
 
 // Sets the specified page directory entry with the start address of physical
@@ -52,7 +272,19 @@ unsigned int get_pdir_entry(unsigned int proc_index, unsigned int pde_index)
 void set_pdir_entry(unsigned int proc_index, unsigned int pde_index,
                     unsigned int page_index)
 {
-    // TODO
+    pdir_write(proc_index, pde_index, page_index * PAGESIZE | PT_PERM_PTU);
+    PTBL_NLIVE[proc_index][pde_index] = 0;
+}
+
+// Maps the page directory entry # [pde_index] of the process # [proc_index]
+// directly to the 4MB physical region starting at page # [page_index],
+// which must be aligned to 1024 pages, with the given permission.
+// No page table is involved in such a mapping.
+void set_pdir_entry_large(unsigned int proc_index, unsigned int pde_index,
+                          unsigned int page_index, unsigned int perm)
+{
+    pdir_write(proc_index, pde_index, page_index * PAGESIZE | perm | PTE_PS);
+    PTBL_NLIVE[proc_index][pde_index] = 0;
 }
 
 // Sets the page directory entry # [pde_index] for the process # [proc_index]
@@ -61,23 +293,73 @@ void set_pdir_entry(unsigned int proc_index, unsigned int pde_index,
 // This will be used to map a page directory entry to an identity page table.
 void set_pdir_entry_identity(unsigned int proc_index, unsigned int pde_index)
 {
-    // TODO
+    pdir_write(proc_index, pde_index, (unsigned int) IDPTbl[pde_index] | PT_PERM_PTU);
+    PTBL_NLIVE[proc_index][pde_index] = 0;
 }
 
 // Removes the specified page directory entry (sets the page directory entry to 0).
 // Don't forget to cast the value to (unsigned int *).
 void rmv_pdir_entry(unsigned int proc_index, unsigned int pde_index)
 {
-    // TODO
+    if (PDirPool[proc_index] == NULL) {
+        return;
+    }
+    pdir_write(proc_index, pde_index, PT_PERM_UP);
+    PTBL_NLIVE[proc_index][pde_index] = 0;
+}
+
+// The entry a page table would hold for the 4KB page # [pte_index] of the
+// 4MB mapping [pde].
+static unsigned int large_pte(unsigned int pde, unsigned int pte_index)
+{
+    return ((pde & 0xffc00000) + pte_index * PAGESIZE) | (pde & 0xfff & ~PTE_PS);
 }
 
 // Returns the specified page table entry.
 // Do not forget that the permission info is also stored in the page directory entries.
+// If the page directory entry is a 4MB mapping, the entry a page table would
+// hold for the 4KB page inside it is returned instead, and if there is no
+// page table, 0 is returned.
 unsigned int get_ptbl_entry(unsigned int proc_index, unsigned int pde_index,
                             unsigned int pte_index)
 {
-    // TODO
-    return 0;
+    unsigned int pde, *ptbl;
+
+    pde = get_pdir_entry(proc_index, pde_index);
+    if ((pde & PTE_P) == 0) {
+        return 0;
+    }
+    if (pde & PTE_PS) {
+        return large_pte(pde, pte_index);
+    }
+
+    ptbl = ptbl_of(proc_index, pde_index);
+    return ptbl[pte_index];
+}
+
+// Copies the [n] page table entries from # [pte_index] on into [ptes], as
+// get_ptbl_entry returns them, looking up the page directory entry only once.
+// [pte_index] + [n] must not exceed 1024.
+void get_ptbl_entries(unsigned int proc_index, unsigned int pde_index,
+                      unsigned int pte_index, unsigned int *ptes, unsigned int n)
+{
+    unsigned int pde, *ptbl, i;
+
+    pde = get_pdir_entry(proc_index, pde_index);
+    if ((pde & PTE_P) == 0) {
+        for (i = 0; i < n; i++) {
+            ptes[i] = 0;
+        }
+    } else if (pde & PTE_PS) {
+        for (i = 0; i < n; i++) {
+            ptes[i] = large_pte(pde, pte_index + i);
+        }
+    } else {
+        ptbl = ptbl_of(proc_index, pde_index);
+        for (i = 0; i < n; i++) {
+            ptes[i] = ptbl[pte_index + i];
+        }
+    }
 }
 
 // Sets the specified page table entry with the start address of physical page # [page_index]
@@ -86,7 +368,24 @@ void set_ptbl_entry(unsigned int proc_index, unsigned int pde_index,
                     unsigned int pte_index, unsigned int page_index,
                     unsigned int perm)
 {
-    // TODO
+    unsigned int *ptbl, pte;
+
+    ptbl = ptbl_of(proc_index, pde_index);
+    pte = page_index * PAGESIZE | perm;
+    if (ptbl[pte_index] == 0 && pte != 0) {
+        PTBL_NLIVE[proc_index][pde_index]++;
+    } else if (ptbl[pte_index] != 0 && pte == 0
+               && PTBL_NLIVE[proc_index][pde_index] > 0) {
+        PTBL_NLIVE[proc_index][pde_index]--;
+    }
+    ptbl[pte_index] = pte;
+}
+
+// Returns the number of nonzero entries in the page table of the page
+// directory entry # [pde_index] of process # [proc_index].
+unsigned int get_ptbl_nlive(unsigned int proc_index, unsigned int pde_index)
+{
+    return PTBL_NLIVE[proc_index][pde_index];
 }
 
 // Sets up the specified page table entry in IDPTbl as the identity map.
@@ -94,12 +393,18 @@ void set_ptbl_entry(unsigned int proc_index, unsigned int pde_index,
 void set_ptbl_entry_identity(unsigned int pde_index, unsigned int pte_index,
                              unsigned int perm)
 {
-    // TODO
+    IDPTbl[pde_index][pte_index] = (pde_index * 1024 + pte_index) * PAGESIZE | perm;
 }
 
 // Sets the specified page table entry to 0.
 void rmv_ptbl_entry(unsigned int proc_index, unsigned int pde_index,
                     unsigned int pte_index)
 {
-    // TODO
+    unsigned int *ptbl;
+
+    ptbl = ptbl_of(proc_index, pde_index);
+    if (ptbl[pte_index] != 0 && PTBL_NLIVE[proc_index][pde_index] > 0) {
+        PTBL_NLIVE[proc_index][pde_index]--;
+    }
+    ptbl[pte_index] = 0;
 }
@@ -3,17 +3,31 @@
 
 #ifdef _KERN_
 
+unsigned int pdir_alloc(unsigned int proc_index);
+void pdir_free(unsigned int proc_index);
 void set_pdir_base(unsigned int index);
+unsigned int pdir_is_active(unsigned int proc_index);
+unsigned int pdir_get_nloads(void);
+unsigned int pdir_get_nskipped(void);
+void tlb_invalidate(unsigned int proc_index, unsigned int vaddr,
+                    unsigned int npages);
+unsigned int tlb_get_ninvlpg(void);
+unsigned int tlb_get_nflushes(void);
 unsigned int get_pdir_entry(unsigned int proc_index, unsigned int pde_index);
 void set_pdir_entry(unsigned int proc_index, unsigned int pde_index,
                     unsigned int page_index);
+void set_pdir_entry_large(unsigned int proc_index, unsigned int pde_index,
+                          unsigned int page_index, unsigned int perm);
 void set_pdir_entry_identity(unsigned int proc_index, unsigned int pde_index);
 void rmv_pdir_entry(unsigned int proc_index, unsigned int pde_index);
 unsigned int get_ptbl_entry(unsigned int proc_index, unsigned int pde_index,
                             unsigned int pte_index);
+void get_ptbl_entries(unsigned int proc_index, unsigned int pde_index,
+                      unsigned int pte_index, unsigned int *ptes, unsigned int n);
 void set_ptbl_entry(unsigned int proc_index, unsigned int pde_index,
                     unsigned int pte_index, unsigned int page_index,
                     unsigned int perm);
+unsigned int get_ptbl_nlive(unsigned int proc_index, unsigned int pde_index);
 void set_ptbl_entry_identity(unsigned int pde_index, unsigned int pte_index,
                              unsigned int perm);
 void rmv_ptbl_entry(unsigned int proc_index, unsigned int pde_index,
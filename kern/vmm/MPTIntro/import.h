@@ -4,6 +4,8 @@
 #ifdef _KERN_
 
 void set_cr3(unsigned int **pdir);  // sets the CR3 register
+unsigned int container_alloc(unsigned int id);
+void container_free(unsigned int id, unsigned int page_index);
 
 #endif  /* _KERN_ */
 
@@ -1,12 +1,17 @@
 #include <lib/x86.h>
 #include <lib/debug.h>
+#include <pmm/MContainer/export.h>
 #include "export.h"
 
-extern char *PDirPool[NUM_IDS][1024];
+extern unsigned int **PDirPool[NUM_IDS];
 extern unsigned int IDPTbl[1024][1024];
 
 int MPTIntro_test1()
 {
+    if (pdir_alloc(1) == 0) {
+        dprintf("test 1.0 failed: (no page directory for process 1)\n");
+        return 1;
+    }
     set_pdir_base(0);
     if ((unsigned int) PDirPool[0] != rcr3()) {
         dprintf("test 1.1 failed: (%d != %d)\n",
@@ -53,6 +58,63 @@ int MPTIntro_test2()
     return 0;
 }
 
+int MPTIntro_test3()
+{
+    unsigned int proc_index = container_split(0, 10);
+    unsigned int page_index;
+    if (get_pdir_entry(proc_index, 0) != 0) {
+        dprintf("test 3.1 failed: (a page directory exists before pdir_alloc)\n");
+        return 1;
+    }
+    page_index = pdir_alloc(proc_index);
+    if (page_index == 0 || container_get_usage(proc_index) != 1) {
+        dprintf("test 3.2 failed: (the page directory is not allocated)\n");
+        return 1;
+    }
+    if (get_pdir_entry(proc_index, 0) != (unsigned int) IDPTbl[0] + 7
+        || get_pdir_entry(proc_index, 256) != 0
+        || get_pdir_entry(proc_index, 960) != (unsigned int) IDPTbl[960] + 7) {
+        dprintf("test 3.3 failed: (the kernel entries are not shared)\n");
+        return 1;
+    }
+    if (get_pdir_entry(proc_index, 1023) != page_index * 4096 + (PTE_P | PTE_W)) {
+        dprintf("test 3.4 failed: (the page directory is not mapped onto itself)\n");
+        return 1;
+    }
+    pdir_free(proc_index);
+    if (get_pdir_entry(proc_index, 0) != 0 || container_get_usage(proc_index) != 0) {
+        dprintf("test 3.5 failed: (the page directory is not freed)\n");
+        return 1;
+    }
+    container_destroy(proc_index);
+    dprintf("test 3 passed.\n");
+    return 0;
+}
+
+int MPTIntro_test4()
+{
+    unsigned int ninvlpg = tlb_get_ninvlpg();
+    unsigned int nflushes = tlb_get_nflushes();
+    set_pdir_base(0);
+    tlb_invalidate(1, 300 * 4096 * 1024, 1);
+    if (tlb_get_ninvlpg() != ninvlpg || tlb_get_nflushes() != nflushes) {
+        dprintf("test 4.1 failed: (a page structure not loaded is invalidated)\n");
+        return 1;
+    }
+    tlb_invalidate(0, 300 * 4096 * 1024, 2);
+    if (tlb_get_ninvlpg() != ninvlpg + 2 || tlb_get_nflushes() != nflushes) {
+        dprintf("test 4.2 failed: (%d != %d)\n", tlb_get_ninvlpg(), ninvlpg + 2);
+        return 1;
+    }
+    tlb_invalidate(0, 300 * 4096 * 1024, 1024);
+    if (tlb_get_ninvlpg() != ninvlpg + 2 || tlb_get_nflushes() != nflushes + 1) {
+        dprintf("test 4.3 failed: (%d != %d)\n", tlb_get_nflushes(), nflushes + 1);
+        return 1;
+    }
+    dprintf("test 4 passed.\n");
+    return 0;
+}
+
 /**
  * Write Your Own Test Script (optional)
  *
@@ -75,5 +137,6 @@ int MPTIntro_test_own()
 
 int test_MPTIntro()
 {
-    return MPTIntro_test1() + MPTIntro_test2() + MPTIntro_test_own();
+    return MPTIntro_test1() + MPTIntro_test2() + MPTIntro_test3() + MPTIntro_test4()
+           + MPTIntro_test_own();
 }
@@ -3,17 +3,24 @@
 
 #include "import.h"
 
+#define VM_USERLO     0x40000000
+#define VM_USERHI     0xF0000000
+#define VM_USERLO_PDE (VM_USERLO / (PAGESIZE * 1024))
+#define VM_USERHI_PDE (VM_USERHI / (PAGESIZE * 1024))
+
 /**
  * Sets the entire page map for process 0 as the identity map.
  * Note that part of the task is already completed by pdir_init.
  */
 void pdir_init_kern(unsigned int mbi_addr)
 {
-    // TODO: Define your local variables here.
+    unsigned int pde_index;
 
     pdir_init(mbi_addr);
 
-    //TODO
+    for (pde_index = VM_USERLO_PDE; pde_index < VM_USERHI_PDE; pde_index++) {
+        set_pdir_entry_identity(0, pde_index);
+    }
 }
 
 /**
@@ -27,8 +34,31 @@ void pdir_init_kern(unsigned int mbi_addr)
 unsigned int map_page(unsigned int proc_index, unsigned int vaddr,
                       unsigned int page_index, unsigned int perm)
 {
-    // TODO
-    return 0;
+    unsigned int pde, ptbl_index, old_pte;
+
+    pde = get_pdir_entry_by_va(proc_index, vaddr);
+    if (pde & PTE_PS) {
+        // the address is covered by a 4MB mapping
+        return MagicNumber;
+    }
+
+    old_pte = 0;
+    if (pde & PTE_P) {
+        ptbl_index = pde / PAGESIZE;
+        old_pte = get_ptbl_entry_by_va(proc_index, vaddr);
+    } else {
+        ptbl_index = alloc_ptbl(proc_index, vaddr);
+        if (ptbl_index == 0) {
+            return MagicNumber;
+        }
+    }
+
+    set_ptbl_entry_by_va(proc_index, vaddr, page_index, perm);
+    if (old_pte & PTE_P) {
+        // a present mapping is replaced, it may be cached in the TLB
+        tlb_invalidate(proc_index, vaddr, 1);
+    }
+    return ptbl_index;
 }
 
 /**
@@ -36,11 +66,232 @@ unsigned int map_page(unsigned int proc_index, unsigned int vaddr,
  * You need to first make sure that the mapping is still valid,
  * e.g., by reading the page table entry for the virtual address.
  * Nothing should be done if the mapping no longer exists.
- * You do not need to unmap the page table from the page directory.
+ * The page table is freed (see free_ptbl_if_empty) once its last entry is removed.
  * It should return the corresponding page table entry.
  */
 unsigned int unmap_page(unsigned int proc_index, unsigned int vaddr)
 {
-    // TODO
-    return 0;
+    unsigned int pte;
+
+    pte = get_ptbl_entry_by_va(proc_index, vaddr);
+    if (pte != 0) {
+        rmv_ptbl_entry_by_va(proc_index, vaddr);
+        free_ptbl_if_empty(proc_index, vaddr);
+    }
+    if (pte & PTE_P) {
+        tlb_invalidate(proc_index, vaddr, 1);
+    }
+    return pte;
+}
+
+/**
+ * Maps the 4MB physical region starting at page # [page_index] at [vaddr]
+ * with the given permission, using a single page directory entry with PTE_PS
+ * instead of a page table. Such a mapping takes one TLB entry for the whole
+ * 4MB, and no page table page.
+ * Both [vaddr] and the physical address must be aligned to 4MB, and the page
+ * directory entry must be unused: a range that already has a page table is
+ * left alone.
+ * It returns [page_index], or MagicNumber in the case of error.
+ */
+unsigned int map_page_large(unsigned int proc_index, unsigned int vaddr,
+                            unsigned int page_index, unsigned int perm)
+{
+    if (vaddr % (PAGESIZE * 1024) != 0 || page_index % 1024 != 0) {
+        return MagicNumber;
+    }
+    if (get_pdir_entry_by_va(proc_index, vaddr) & PTE_P) {
+        return MagicNumber;
+    }
+    if (pdir_alloc(proc_index) == 0) {
+        return MagicNumber;
+    }
+
+    set_pdir_entry_large_by_va(proc_index, vaddr, page_index, perm);
+    return page_index;
+}
+
+/**
+ * Removes the 4MB mapping at [vaddr] set up by map_page_large.
+ * Nothing is done if the page directory entry is not a 4MB mapping.
+ * It returns the removed page directory entry, or 0.
+ */
+unsigned int unmap_page_large(unsigned int proc_index, unsigned int vaddr)
+{
+    unsigned int pde;
+
+    pde = get_pdir_entry_by_va(proc_index, vaddr);
+    if ((pde & PTE_P) == 0 || (pde & PTE_PS) == 0) {
+        return 0;
+    }
+
+    rmv_pdir_entry_by_va(proc_index, vaddr);
+    // a single invlpg drops the whole 4MB entry
+    tlb_invalidate(proc_index, vaddr, 1);
+    return pde;
+}
+
+/**
+ * The range operations below walk the page tables directly: the page
+ * directory entry is looked up once for the (up to 1024) pages of each page
+ * table in the range, and the TLB is invalidated once for the whole range.
+ * Ranges are given as a page aligned [vaddr] and a number of pages, and must
+ * lie in the user portion: the page tables of the kernel portion are the
+ * identity page tables shared by all the page structures.
+ */
+static unsigned int range_valid(unsigned int vaddr, unsigned int npages)
+{
+    return vaddr % PAGESIZE == 0 && VM_USERLO <= vaddr && vaddr < VM_USERHI
+           && npages <= (VM_USERHI - vaddr) / PAGESIZE;
+}
+
+// The number of pages of the range from [vaddr] to the end of its page table.
+static unsigned int range_span(unsigned int vaddr, unsigned int npages)
+{
+    unsigned int n = 1024 - vaddr / PAGESIZE % 1024;
+    return n < npages ? n : npages;
+}
+
+/**
+ * Removes the mappings of the [npages] pages starting at [vaddr].
+ * The page tables left empty are freed, and 4MB mappings are left alone.
+ * It returns the number of page table entries removed.
+ */
+unsigned int unmap_range(unsigned int proc_index, unsigned int vaddr,
+                         unsigned int npages)
+{
+    unsigned int i, j, n, va, pde, pde_index, pte_index, pte;
+    unsigned int nremoved, npresent;
+
+    if (!range_valid(vaddr, npages)) {
+        return 0;
+    }
+
+    nremoved = 0;
+    npresent = 0;
+    for (i = 0; i < npages; i += n) {
+        va = vaddr + i * PAGESIZE;
+        n = range_span(va, npages - i);
+        pde = get_pdir_entry_by_va(proc_index, va);
+        if ((pde & PTE_P) == 0 || (pde & PTE_PS)) {
+            continue;
+        }
+        pde_index = va / (PAGESIZE * 1024);
+        pte_index = va / PAGESIZE % 1024;
+        for (j = 0; j < n; j++) {
+            pte = get_ptbl_entry(proc_index, pde_index, pte_index + j);
+            if (pte != 0) {
+                rmv_ptbl_entry(proc_index, pde_index, pte_index + j);
+                nremoved++;
+                npresent += pte & PTE_P;
+            }
+        }
+        free_ptbl_if_empty(proc_index, va);
+    }
+
+    if (npresent > 0) {
+        tlb_invalidate(proc_index, vaddr, npages);
+    }
+    return nremoved;
+}
+
+/**
+ * Maps the [npages] physically contiguous pages starting at page # [page_index]
+ * at [vaddr] with the given permission, allocating the missing page tables.
+ * The page tables are all set up before any entry is written, so in the case
+ * of error (a 4MB mapping in the range, or no page left for a page table),
+ * the page tables allocated so far are freed again, the mappings of the range
+ * are left as they were, and MagicNumber is returned.
+ * Otherwise, it returns [npages].
+ */
+unsigned int map_range(unsigned int proc_index, unsigned int vaddr,
+                       unsigned int page_index, unsigned int npages,
+                       unsigned int perm)
+{
+    unsigned int i, j, n, va, pde, pde_index, pte_index, npresent;
+
+    if (!range_valid(vaddr, npages)) {
+        return MagicNumber;
+    }
+
+    for (i = 0; i < npages; i += n) {
+        va = vaddr + i * PAGESIZE;
+        n = range_span(va, npages - i);
+        pde = get_pdir_entry_by_va(proc_index, va);
+        if ((pde & PTE_PS)
+            || ((pde & PTE_P) == 0 && alloc_ptbl(proc_index, va) == 0)) {
+            // only the page tables allocated above are still empty
+            for (j = 0; j < i; j += range_span(vaddr + j * PAGESIZE, i - j)) {
+                free_ptbl_if_empty(proc_index, vaddr + j * PAGESIZE);
+            }
+            return MagicNumber;
+        }
+    }
+
+    npresent = 0;
+    for (i = 0; i < npages; i += n) {
+        va = vaddr + i * PAGESIZE;
+        n = range_span(va, npages - i);
+        pde_index = va / (PAGESIZE * 1024);
+        pte_index = va / PAGESIZE % 1024;
+        for (j = 0; j < n; j++) {
+            npresent += get_ptbl_entry(proc_index, pde_index, pte_index + j) & PTE_P;
+            set_ptbl_entry(proc_index, pde_index, pte_index + j,
+                           page_index + i + j, perm);
+        }
+    }
+
+    // only present mappings that were replaced may be cached in the TLB
+    if (npresent > 0) {
+        tlb_invalidate(proc_index, vaddr, npages);
+    }
+    return npages;
+}
+
+/**
+ * Changes the permission of the present pages among the [npages] pages
+ * starting at [vaddr] to [perm], keeping the physical pages they map.
+ * The software bits of the entries (PTE_COW, PTE_SHM) are kept as they are,
+ * and a copy-on-write page never gets PTE_W: the first write still goes
+ * through cow_fault, which gives write access back.
+ * 4MB mappings are left alone.
+ * It returns the number of pages changed.
+ */
+unsigned int protect_range(unsigned int proc_index, unsigned int vaddr,
+                           unsigned int npages, unsigned int perm)
+{
+    unsigned int i, j, n, va, pde, pde_index, pte_index, pte, pte_perm, nchanged;
+
+    if (!range_valid(vaddr, npages)) {
+        return 0;
+    }
+
+    nchanged = 0;
+    for (i = 0; i < npages; i += n) {
+        va = vaddr + i * PAGESIZE;
+        n = range_span(va, npages - i);
+        pde = get_pdir_entry_by_va(proc_index, va);
+        if ((pde & PTE_P) == 0 || (pde & PTE_PS)) {
+            continue;
+        }
+        pde_index = va / (PAGESIZE * 1024);
+        pte_index = va / PAGESIZE % 1024;
+        for (j = 0; j < n; j++) {
+            pte = get_ptbl_entry(proc_index, pde_index, pte_index + j);
+            if (pte & PTE_P) {
+                pte_perm = (perm & ~(PTE_COW | PTE_SHM)) | (pte & (PTE_COW | PTE_SHM));
+                if (pte_perm & PTE_COW) {
+                    pte_perm &= ~PTE_W;
+                }
+                set_ptbl_entry(proc_index, pde_index, pte_index + j,
+                               pte / PAGESIZE, pte_perm);
+                nchanged++;
+            }
+        }
+    }
+
+    if (nchanged > 0) {
+        tlb_invalidate(proc_index, vaddr, npages);
+    }
+    return nchanged;
 }
@@ -7,6 +7,16 @@ void pdir_init_kern(unsigned int mbi_addr);
 unsigned int map_page(unsigned int proc_index, unsigned int vaddr,
                       unsigned int page_index, unsigned int perm);
 unsigned int unmap_page(unsigned int proc_index, unsigned int vaddr);
+unsigned int map_page_large(unsigned int proc_index, unsigned int vaddr,
+                            unsigned int page_index, unsigned int perm);
+unsigned int unmap_page_large(unsigned int proc_index, unsigned int vaddr);
+unsigned int unmap_range(unsigned int proc_index, unsigned int vaddr,
+                         unsigned int npages);
+unsigned int map_range(unsigned int proc_index, unsigned int vaddr,
+                       unsigned int page_index, unsigned int npages,
+                       unsigned int perm);
+unsigned int protect_range(unsigned int proc_index, unsigned int vaddr,
+                           unsigned int npages, unsigned int perm);
 
 #endif  /* _KERN_ */
 
@@ -4,13 +4,27 @@
 #ifdef _KERN_
 
 void pdir_init(unsigned int mbi_addr);
+unsigned int pdir_alloc(unsigned int proc_index);
 void set_pdir_entry_identity(unsigned int proc_index, unsigned int pde_index);
 unsigned int get_pdir_entry_by_va(unsigned int proc_index, unsigned int vaddr);
 unsigned int alloc_ptbl(unsigned int proc_index, unsigned int vaddr);
+void free_ptbl_if_empty(unsigned int proc_index, unsigned int vaddr);
 void set_ptbl_entry_by_va(unsigned int proc_index, unsigned int vaddr,
                           unsigned int page_index, unsigned int perm);
+void set_pdir_entry_large_by_va(unsigned int proc_index, unsigned int vaddr,
+                                unsigned int page_index, unsigned int perm);
+void rmv_pdir_entry_by_va(unsigned int proc_index, unsigned int vaddr);
 void rmv_ptbl_entry_by_va(unsigned int proc_index, unsigned int vaddr);
 unsigned int get_ptbl_entry_by_va(unsigned int proc_index, unsigned int vaddr);
+unsigned int get_ptbl_entry(unsigned int proc_index, unsigned int pde_index,
+                            unsigned int pte_index);
+void set_ptbl_entry(unsigned int proc_index, unsigned int pde_index,
+                    unsigned int pte_index, unsigned int page_index,
+                    unsigned int perm);
+void rmv_ptbl_entry(unsigned int proc_index, unsigned int pde_index,
+                    unsigned int pte_index);
+void tlb_invalidate(unsigned int proc_index, unsigned int vaddr,
+                    unsigned int npages);
 
 #endif  /* _KERN_ */
 
@@ -1,5 +1,7 @@
 #include <lib/debug.h>
+#include <lib/x86.h>
 #include <pmm/MContainer/export.h>
+#include <vmm/MPTIntro/export.h>
 #include <vmm/MPTOp/export.h>
 #include "export.h"
 
@@ -49,6 +51,157 @@ int MPTKern_test2()
     return 0;
 }
 
+int MPTKern_test3()
+{
+    unsigned int vaddr = 4096 * 1024 * 500;
+    unsigned int page_index = 1024 * 200;
+    if (map_page_large(1, vaddr + 4096, page_index, 7) != MagicNumber) {
+        dprintf("test 3.1 failed: (an unaligned address is mapped)\n");
+        return 1;
+    }
+    if (map_page_large(1, vaddr, page_index, 7) != page_index) {
+        dprintf("test 3.2 failed: (%d != %d)\n",
+                map_page_large(1, vaddr, page_index, 7), page_index);
+        return 1;
+    }
+    if ((get_pdir_entry_by_va(1, vaddr) & PTE_PS) == 0) {
+        dprintf("test 3.3 failed: (%d is not a 4MB mapping)\n",
+                get_pdir_entry_by_va(1, vaddr));
+        unmap_page_large(1, vaddr);
+        return 1;
+    }
+    if (get_ptbl_entry_by_va(1, vaddr + 5 * 4096) != (page_index + 5) * 4096 + 7) {
+        dprintf("test 3.4 failed: (%d != %d)\n",
+                get_ptbl_entry_by_va(1, vaddr + 5 * 4096),
+                (page_index + 5) * 4096 + 7);
+        unmap_page_large(1, vaddr);
+        return 1;
+    }
+    if (map_page(1, vaddr + 4096, 100, 7) != MagicNumber) {
+        dprintf("test 3.5 failed: (a 4KB page is mapped inside a 4MB mapping)\n");
+        unmap_page_large(1, vaddr);
+        return 1;
+    }
+    unmap_page_large(1, vaddr);
+    if (get_pdir_entry_by_va(1, vaddr) != 0) {
+        dprintf("test 3.6 failed: (%d != 0)\n", get_pdir_entry_by_va(1, vaddr));
+        return 1;
+    }
+    dprintf("test 3 passed.\n");
+    return 0;
+}
+
+int MPTKern_test4()
+{
+    unsigned int vaddr = 4096 * 1024 * 451 - 2 * 4096;  // across two page tables
+    unsigned int page_index = 1024 * 200;
+    unsigned int i;
+    if (map_range(1, vaddr + 1, page_index, 4, 7) != MagicNumber) {
+        dprintf("test 4.1 failed: (an unaligned range is mapped)\n");
+        return 1;
+    }
+    if (map_range(1, 0x40000000 - 4096, page_index, 2, 7) != MagicNumber
+        || map_range(1, 0xF0000000 - 4096, page_index, 2, 7) != MagicNumber
+        || unmap_range(1, 0x100000, 1) != 0 || protect_range(1, 0x100000, 1, 7) != 0
+        || (get_ptbl_entry_by_va(0, 0x100000) & PTE_P) == 0) {
+        dprintf("test 4.2 failed: (a range outside of the user portion is changed)\n");
+        return 1;
+    }
+    if (map_range(1, vaddr, page_index, 4, 7) != 4) {
+        dprintf("test 4.3 failed: (the range is not mapped)\n");
+        return 1;
+    }
+    for (i = 0; i < 4; i++) {
+        if (get_ptbl_entry_by_va(1, vaddr + i * 4096) != (page_index + i) * 4096 + 7) {
+            dprintf("test 4.4 failed (i = %d): (%d != %d)\n", i,
+                    get_ptbl_entry_by_va(1, vaddr + i * 4096), (page_index + i) * 4096 + 7);
+            unmap_range(1, vaddr, 4);
+            return 1;
+        }
+    }
+    if (protect_range(1, vaddr, 8, PTE_P | PTE_U) != 4
+        || get_ptbl_entry_by_va(1, vaddr + 3 * 4096) != (page_index + 3) * 4096 + 5) {
+        dprintf("test 4.5 failed: (the permission is not changed)\n");
+        unmap_range(1, vaddr, 4);
+        return 1;
+    }
+    if (unmap_range(1, vaddr, 8) != 4 || get_ptbl_entry_by_va(1, vaddr + 2 * 4096) != 0) {
+        dprintf("test 4.6 failed: (the range is not unmapped)\n");
+        return 1;
+    }
+    dprintf("test 4 passed.\n");
+    return 0;
+}
+
+int MPTKern_test5()
+{
+    unsigned int vaddr = 4096 * 1024 * 452;
+    unsigned int usage = container_get_usage(1);
+    map_page(1, vaddr, 100, 7);
+    map_page(1, vaddr + 4096, 101, 7);
+    if (get_ptbl_nlive(1, 452) != 2 || container_get_usage(1) != usage + 1) {
+        dprintf("test 5.1 failed: (%d != 2)\n", get_ptbl_nlive(1, 452));
+        unmap_range(1, vaddr, 2);
+        return 1;
+    }
+    unmap_page(1, vaddr);
+    if (get_pdir_entry_by_va(1, vaddr) == 0 || get_ptbl_nlive(1, 452) != 1) {
+        dprintf("test 5.2 failed: (a page table in use is freed)\n");
+        unmap_range(1, vaddr, 2);
+        return 1;
+    }
+    unmap_page(1, vaddr + 4096);
+    if (get_pdir_entry_by_va(1, vaddr) != 0 || container_get_usage(1) != usage) {
+        dprintf("test 5.3 failed: (the empty page table is not freed)\n");
+        return 1;
+    }
+    dprintf("test 5 passed.\n");
+    return 0;
+}
+
+int MPTKern_test6()
+{
+    unsigned int vaddr = 4096 * 1024 * 452;
+    unsigned int usage = container_get_usage(1);
+    map_page(1, vaddr + 1024 * 4096, 100, 7);
+    map_page_large(1, vaddr + 2048 * 4096, 1024 * 200, 7);
+    if (map_range(1, vaddr, 1024 * 300, 2049, 7) != MagicNumber) {
+        dprintf("test 6.1 failed: (a range over a 4MB mapping is mapped)\n");
+        unmap_range(1, vaddr, 2048);
+        unmap_page_large(1, vaddr + 2048 * 4096);
+        return 1;
+    }
+    if (get_ptbl_entry_by_va(1, vaddr + 1024 * 4096) != 100 * 4096 + 7
+        || get_pdir_entry_by_va(1, vaddr) != 0 || container_get_usage(1) != usage + 1) {
+        dprintf("test 6.2 failed: (the failed mapping changed the page structure)\n");
+        unmap_range(1, vaddr, 2048);
+        unmap_page_large(1, vaddr + 2048 * 4096);
+        return 1;
+    }
+    unmap_page(1, vaddr + 1024 * 4096);
+    unmap_page_large(1, vaddr + 2048 * 4096);
+    dprintf("test 6 passed.\n");
+    return 0;
+}
+
+int MPTKern_test7()
+{
+    unsigned int vaddr = 4096 * 1024 * 453;
+    map_page(1, vaddr, 100, PTE_P | PTE_U | PTE_COW);
+    map_page(1, vaddr + 4096, 101, PTE_P | PTE_U | PTE_SHM);
+    if (protect_range(1, vaddr, 2, PTE_P | PTE_U | PTE_W) != 2
+        || get_ptbl_entry_by_va(1, vaddr) != 100 * 4096 + (PTE_P | PTE_U | PTE_COW)
+        || get_ptbl_entry_by_va(1, vaddr + 4096)
+           != 101 * 4096 + (PTE_P | PTE_U | PTE_W | PTE_SHM)) {
+        dprintf("test 7.1 failed: (the software bits are not kept)\n");
+        unmap_range(1, vaddr, 2);
+        return 1;
+    }
+    unmap_range(1, vaddr, 2);
+    dprintf("test 7 passed.\n");
+    return 0;
+}
+
 /**
  * Write Your Own Test Script (optional)
  *
@@ -71,5 +224,6 @@ int MPTKern_test_own()
 
 int test_MPTKern()
 {
-    return MPTKern_test1() + MPTKern_test2() + MPTKern_test_own();
+    return MPTKern_test1() + MPTKern_test2() + MPTKern_test3() + MPTKern_test4() + MPTKern_test5()
+           + MPTKern_test6() + MPTKern_test7() + MPTKern_test_own();
 }
@@ -1,7 +1,36 @@
+#include <lib/kmap.h>
+#include <lib/string.h>
 #include <lib/x86.h>
 
 #include "import.h"
 
+#define VM_USERLO     0x40000000
+#define VM_USERHI     0xF0000000
+#define VM_USERLO_PDE (VM_USERLO / (PAGESIZE * 1024))
+#define VM_USERHI_PDE (VM_USERHI / (PAGESIZE * 1024))
+
+/**
+ * The largest number of pages fault_around maps in one fault.
+ * It can be changed at build time, e.g., FAULT_AROUND_PAGES=32 make.
+ */
+#ifndef FAULT_AROUND_PAGES
+#define FAULT_AROUND_PAGES 16
+#endif
+
+/**
+ * Per-process state of the sequential fault detector.
+ * FAULT_NEXT: the page right after the ones mapped by the last fault.
+ * FAULT_WINDOW: the number of pages mapped by the last fault.
+ */
+static unsigned int FAULT_NEXT[NUM_IDS];
+static unsigned int FAULT_WINDOW[NUM_IDS];
+
+// The number of pages reclaimed at once when physical memory runs out.
+#define RECLAIM_BATCH 32
+
+// The number of pages pdir_destroy hands back to the allocator at once.
+#define DESTROY_BATCH 64
+
 /**
  * This function will be called when there's no mapping found in the page structure
  * for the given virtual address [vaddr], e.g., by the page fault handler when
@@ -12,20 +41,367 @@
  * It should return the physical page index registered in the page directory, the
  * return value from map_page.
  * In the case of error, it should return the constant MagicNumber.
+ *
+ * The page is always filled with zeros, so callers do not need to clear it.
+ * It is taken from the pre-zeroed pool whenever possible, which keeps the
+ * zeroing off the page fault path.
+ * When physical memory runs out, cold pages are evicted to the compressed
+ * store (see reclaim_pages) and the allocation is retried once.
  */
 unsigned int alloc_page(unsigned int proc_index, unsigned int vaddr,
                         unsigned int perm)
 {
-    // TODO
-    return 0;
+    unsigned int page_index, pde_page_index;
+
+    page_index = container_alloc_zeroed(proc_index);
+    if (page_index == 0 && container_can_consume(proc_index, 1)
+        && reclaim_pages(RECLAIM_BATCH) > 0) {
+        page_index = container_alloc_zeroed(proc_index);
+    }
+    if (page_index == 0) {
+        return MagicNumber;
+    }
+
+    pde_page_index = map_page(proc_index, vaddr, page_index, perm);
+    if (pde_page_index == MagicNumber) {
+        container_free(proc_index, page_index);
+    }
+
+    return pde_page_index;
+}
+
+/**
+ * Handles a page fault at [vaddr] of process # [proc_index] with alloc_page,
+ * mapping the pages that follow it as well when the process faults
+ * sequentially. Each fault right after the window mapped by the previous one
+ * doubles the window, up to FAULT_AROUND_PAGES pages; any other fault
+ * resets it to the faulting page alone.
+ * The extra pages are charged like any other page, and the window stops early
+ * at the first page that is already mapped (or evicted, see swap_in), at the
+ * first page of a lazily loaded ELF segment (see elf_fault), at the end of the
+ * user range, or when the process would exceed its quota.
+ * It returns the number of pages mapped, or MagicNumber if not even the
+ * faulting page could be mapped.
+ */
+unsigned int fault_around(unsigned int proc_index, unsigned int vaddr,
+                          unsigned int perm)
+{
+    unsigned int window, npages, va;
+
+    vaddr = vaddr / PAGESIZE * PAGESIZE;
+
+    if (vaddr == FAULT_NEXT[proc_index]) {
+        window = FAULT_WINDOW[proc_index] * 2;
+        if (window > FAULT_AROUND_PAGES) {
+            window = FAULT_AROUND_PAGES;
+        }
+    } else {
+        window = 1;
+    }
+
+    if (alloc_page(proc_index, vaddr, perm) == MagicNumber) {
+        return MagicNumber;
+    }
+
+    for (npages = 1; npages < window; npages++) {
+        va = vaddr + npages * PAGESIZE;
+        if (va >= VM_USERHI
+            || get_ptbl_entry_by_va(proc_index, va) != 0
+            || elf_covers(proc_index, va)
+            || !container_can_consume(proc_index, 1)) {
+            break;
+        }
+        if (alloc_page(proc_index, va, perm) == MagicNumber) {
+            break;
+        }
+    }
+
+    FAULT_NEXT[proc_index] = vaddr + npages * PAGESIZE;
+    FAULT_WINDOW[proc_index] = npages;
+    return npages;
+}
+
+/**
+ * Backs the 4MB region at [vaddr] with a single 4MB mapping, for large
+ * anonymous regions. The 1024 physical pages come from one aligned contiguous
+ * allocation charged to the container, and are filled with zeros.
+ * [vaddr] must be aligned to 4MB and not mapped yet.
+ * It returns the index of the first physical page, or MagicNumber in the case
+ * of error (including when the quota or contiguous memory runs out).
+ */
+unsigned int alloc_page_large(unsigned int proc_index, unsigned int vaddr,
+                              unsigned int perm)
+{
+    unsigned int page_index, i;
+
+    if (vaddr % (PAGESIZE * 1024) != 0) {
+        return MagicNumber;
+    }
+
+    // palloc_range hands out a 1024 page range as one buddy block, aligned to 4MB
+    page_index = container_alloc_range(proc_index, 1024);
+    if (page_index == 0) {
+        return MagicNumber;
+    }
+    for (i = 0; i < 1024; i++) {
+        memzero(kmap(KMAP_DST, page_index + i), PAGESIZE);
+    }
+
+    if (map_page_large(proc_index, vaddr, page_index, perm) == MagicNumber) {
+        container_free_range(proc_index, page_index, 1024);
+        return MagicNumber;
+    }
+
+    return page_index;
+}
+
+// Reverse operation of alloc_page_large.
+// Removes the 4MB mapping at [vaddr] and returns its pages to the container.
+void free_page_large(unsigned int proc_index, unsigned int vaddr)
+{
+    unsigned int pde;
+
+    pde = unmap_page_large(proc_index, vaddr);
+    if (pde != 0) {
+        container_free_range(proc_index, pde / PAGESIZE, 1024);
+    }
 }
 
 /**
- * Designate some memory quota for the next child process.
+ * Duplicates the user address space of process # [from] into process # [to]
+ * without copying any page: both processes map the same physical pages,
+ * and the writable ones are made read-only and marked with PTE_COW in both
+ * page structures, to be copied on the first write (see cow_fault).
+ * Only the page tables of [to] are allocated.
+ *
+ * Process # [to] must not have any user mapping yet, and [from] cannot be
+ * the kernel process 0 (whose user range is the identity map) nor have 4MB
+ * mappings. Each shared page is charged to [to] as well (except for the pages
+ * of the kernel image, which are never charged), and the whole
+ * operation fails before changing anything if [to] does not have the quota.
+ * Pages of [from] that were evicted to the compressed store are brought back
+ * first (charged to [from]), so that they can be shared.
+ * Shared memory segments are not inherited: [to] has to map them itself
+ * (see shm_attach).
+ * The stale writable TLB entries of [from] are invalidated as its pages are
+ * made read-only.
+ * Returns the number of pages shared, or MagicNumber in the case of error.
+ * Past the quota check, an error (no memory for a page table of [to], or to
+ * bring an evicted page back) leaves the work done so far in place: [to] maps
+ * and is charged for the pages shared until then, and should be torn down
+ * with pdir_destroy, while the pages of [from] already marked PTE_COW stay
+ * so, which is harmless since cow_fault gives the last process referencing a
+ * page its write access back.
+ */
+unsigned int pdir_dup_cow(unsigned int from, unsigned int to)
+{
+    unsigned int pde_index, vaddr, va, pde, pte, page_index, perm;
+    unsigned int npages, nshared;
+
+    if (from == 0 || from == to) {
+        return MagicNumber;
+    }
+
+    // count the pages to charge to [to], and check that the copy is possible
+    npages = 0;
+    for (pde_index = VM_USERLO_PDE; pde_index < VM_USERHI_PDE; pde_index++) {
+        vaddr = pde_index * PAGESIZE * 1024;
+        pde = get_pdir_entry_by_va(from, vaddr);
+        if ((pde & PTE_P) == 0) {
+            continue;
+        }
+        if ((pde & PTE_PS) || (get_pdir_entry_by_va(to, vaddr) & PTE_P)) {
+            return MagicNumber;
+        }
+        npages++;
+        for (va = vaddr; va < vaddr + PAGESIZE * 1024; va += PAGESIZE) {
+            pte = get_ptbl_entry_by_va(from, va);
+            if (pte & PTE_SHM) {
+                continue;
+            }
+            if (((pte & PTE_P) && at_is_norm(pte / PAGESIZE)) || (pte & PTE_ZSWAP)) {
+                npages++;
+            }
+        }
+    }
+    if (!container_can_consume(to, npages)) {
+        return MagicNumber;
+    }
+
+    nshared = 0;
+    for (pde_index = VM_USERLO_PDE; pde_index < VM_USERHI_PDE; pde_index++) {
+        vaddr = pde_index * PAGESIZE * 1024;
+        if ((get_pdir_entry_by_va(from, vaddr) & PTE_P) == 0) {
+            continue;
+        }
+        for (va = vaddr; va < vaddr + PAGESIZE * 1024; va += PAGESIZE) {
+            if (swap_in(from, va) == MagicNumber) {
+                return MagicNumber;
+            }
+            pte = get_ptbl_entry_by_va(from, va);
+            if ((pte & PTE_P) == 0 || (pte & PTE_SHM)) {
+                continue;
+            }
+
+            page_index = pte / PAGESIZE;
+            perm = pte & (PTE_P | PTE_W | PTE_U | PTE_COW);
+            if (perm & PTE_W) {
+                perm = (perm & ~PTE_W) | PTE_COW;
+                set_ptbl_entry_by_va(from, va, page_index, perm);
+                tlb_invalidate(from, va, 1);
+            }
+
+            if (map_page(to, va, page_index, perm) == MagicNumber) {
+                return MagicNumber;
+            }
+            if (at_is_norm(page_index)) {
+                container_share(to, page_index);
+            }
+            nshared++;
+        }
+    }
+
+    return nshared;
+}
+
+/**
+ * Resolves a write to the copy-on-write page at [vaddr] of process
+ * # [proc_index]. If other processes still reference the physical page, it is
+ * copied to a new page (charged to the process) and the reference to the
+ * shared one is dropped; the last process referencing it simply gets write
+ * access back.
+ * Returns 1 if the fault was resolved, 0 if the address is not mapped
+ * copy-on-write, and MagicNumber if no page is available for the copy.
+ */
+unsigned int cow_fault(unsigned int proc_index, unsigned int vaddr)
+{
+    unsigned int pte, page_index, new_page_index, perm;
+
+    pte = get_ptbl_entry_by_va(proc_index, vaddr);
+    if ((pte & PTE_P) == 0 || (pte & PTE_COW) == 0) {
+        return 0;
+    }
+
+    page_index = pte / PAGESIZE;
+    perm = (pte & (PTE_P | PTE_U)) | PTE_W;
+
+    if (at_get_refcnt(page_index) == 1) {
+        set_ptbl_entry_by_va(proc_index, vaddr, page_index, perm);
+        tlb_invalidate(proc_index, vaddr, 1);
+        return 1;
+    }
+
+    new_page_index = container_alloc(proc_index);
+    if (new_page_index == 0 && container_can_consume(proc_index, 1)
+        && reclaim_pages(RECLAIM_BATCH) > 0) {
+        new_page_index = container_alloc(proc_index);
+    }
+    if (new_page_index == 0) {
+        return MagicNumber;
+    }
+    memcpy(kmap(KMAP_DST, new_page_index), kmap(KMAP_SRC, page_index), PAGESIZE);
+    set_ptbl_entry_by_va(proc_index, vaddr, new_page_index, perm);
+    tlb_invalidate(proc_index, vaddr, 1);
+    container_free(proc_index, page_index);
+
+    return 1;
+}
+
+/**
+ * Designate some memory quota for the next child process,
+ * and allocates its page directory (charged to the child).
+ * The page structures only exist for the first NUM_IDS container ids, which
+ * container_split keeps for processes (see container_split_group).
+ * Returns NUM_IDS in the case of error.
  */
 unsigned int alloc_mem_quota(unsigned int id, unsigned int quota)
 {
     unsigned int child;
     child = container_split(id, quota);
+    if (child >= NUM_IDS || pdir_alloc(child) == 0) {
+        if (child != NUM_CONTAINERS) {
+            container_destroy(child);
+        }
+        return NUM_IDS;
+    }
     return child;
 }
+
+/**
+ * Reverse operation of alloc_mem_quota: tears down the whole address space of
+ * process # [proc_index] and destroys its container, giving its quota back
+ * to the parent.
+ * Its shared memory segments are detached first (see shm_release_proc).
+ * The page directory is walked once. The pages mapped by the process are
+ * released DESTROY_BATCH at a time (see container_free_batch), 4MB mappings
+ * as one range, and evicted pages are dropped from the compressed store.
+ * Pages that are not normal, i.e., the ones of the kernel image mapped by
+ * the ELF loader, are not charged to the process and are left alone.
+ * The page tables and the page directory go last, together with the segments
+ * recorded for the process by the lazy ELF loader (see elf_unload).
+ * The process cannot be process 0 nor have children.
+ * Returns the number of pages released, page tables and page directory
+ * excluded, or MagicNumber in the case of error. That includes a container
+ * that is still charged for some pages once everything is released, which
+ * is then left in place, but without its address space.
+ */
+unsigned int pdir_destroy(unsigned int proc_index)
+{
+    unsigned int pages[DESTROY_BATCH];
+    unsigned int pde_index, pte_index, pde, pte, npages, nreleased;
+
+    if (proc_index == 0 || proc_index >= NUM_IDS || !container_is_used(proc_index)
+        || container_get_nchildren(proc_index) != 0) {
+        return MagicNumber;
+    }
+
+    // the page structure may be the one loaded on this CPU
+    set_pdir_base(0);
+    shm_release_proc(proc_index);
+
+    npages = 0;
+    nreleased = 0;
+    for (pde_index = VM_USERLO_PDE; pde_index < VM_USERHI_PDE; pde_index++) {
+        pde = get_pdir_entry(proc_index, pde_index);
+        if ((pde & PTE_P) == 0) {
+            continue;
+        }
+        if (pde & PTE_PS) {
+            rmv_pdir_entry(proc_index, pde_index);
+            container_free_range(proc_index, pde / PAGESIZE, 1024);
+            nreleased += 1024;
+            continue;
+        }
+        for (pte_index = 0; pte_index < 1024; pte_index++) {
+            pte = get_ptbl_entry(proc_index, pde_index, pte_index);
+            if (pte & PTE_P) {
+                if (!at_is_norm(pte / PAGESIZE)) {
+                    continue;
+                }
+                pages[npages] = pte / PAGESIZE;
+                npages++;
+                if (npages == DESTROY_BATCH) {
+                    container_free_batch(proc_index, pages, npages);
+                    nreleased += npages;
+                    npages = 0;
+                }
+            } else if (pte & PTE_ZSWAP) {
+                swap_discard(proc_index, (pde_index * 1024 + pte_index) * PAGESIZE);
+                nreleased++;
+            }
+        }
+    }
+    container_free_batch(proc_index, pages, npages);
+    nreleased += npages;
+
+    free_all_ptbl(proc_index);
+    pdir_free(proc_index);
+    elf_unload(proc_index);
+    FAULT_NEXT[proc_index] = 0;
+    FAULT_WINDOW[proc_index] = 0;
+    if (container_destroy(proc_index) == 0) {
+        return MagicNumber;
+    }
+
+    return nreleased;
+}
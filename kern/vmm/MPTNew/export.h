@@ -5,7 +5,15 @@
 
 unsigned int alloc_page(unsigned int proc_index, unsigned int vaddr,
                         unsigned int perm);
+unsigned int fault_around(unsigned int proc_index, unsigned int vaddr,
+                          unsigned int perm);
+unsigned int alloc_page_large(unsigned int proc_index, unsigned int vaddr,
+                              unsigned int perm);
+void free_page_large(unsigned int proc_index, unsigned int vaddr);
+unsigned int pdir_dup_cow(unsigned int from, unsigned int to);
+unsigned int cow_fault(unsigned int proc_index, unsigned int vaddr);
 unsigned int alloc_mem_quota(unsigned int id, unsigned int quota);
+unsigned int pdir_destroy(unsigned int proc_index);
 
 #endif  /* _KERN_ */
 
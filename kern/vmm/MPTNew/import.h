@@ -3,11 +3,46 @@
 
 #ifdef _KERN_
 
+unsigned int at_get_refcnt(unsigned int page_index);
+unsigned int container_can_consume(unsigned int id, unsigned int n);
 unsigned int container_alloc(unsigned int id);
+void container_share(unsigned int id, unsigned int page_index);
+unsigned int get_pdir_entry_by_va(unsigned int proc_index, unsigned int vaddr);
+unsigned int get_ptbl_entry_by_va(unsigned int proc_index, unsigned int vaddr);
+void set_ptbl_entry_by_va(unsigned int proc_index, unsigned int vaddr,
+                          unsigned int page_index, unsigned int perm);
+unsigned int container_alloc_zeroed(unsigned int id);
 void container_free(unsigned int id, unsigned int page_index);
 unsigned int container_split(unsigned int id, unsigned int quota);
+unsigned int container_destroy(unsigned int id);
+unsigned int pdir_alloc(unsigned int proc_index);
+unsigned int container_alloc_range(unsigned int id, unsigned int n);
+void container_free_range(unsigned int id, unsigned int page_index,
+                          unsigned int n);
+unsigned int map_page_large(unsigned int proc_index, unsigned int vaddr,
+                            unsigned int page_index, unsigned int perm);
+unsigned int unmap_page_large(unsigned int proc_index, unsigned int vaddr);
 unsigned int map_page(unsigned int proc_index, unsigned int vaddr,
                       unsigned int page_index, unsigned int perm);
+unsigned int reclaim_pages(unsigned int n);
+unsigned int swap_in(unsigned int proc_index, unsigned int vaddr);
+void tlb_invalidate(unsigned int proc_index, unsigned int vaddr,
+                    unsigned int npages);
+unsigned int at_is_norm(unsigned int page_index);
+unsigned int container_is_used(unsigned int id);
+unsigned int container_get_nchildren(unsigned int id);
+void container_free_batch(unsigned int id, unsigned int *pages, unsigned int n);
+unsigned int get_pdir_entry(unsigned int proc_index, unsigned int pde_index);
+unsigned int get_ptbl_entry(unsigned int proc_index, unsigned int pde_index,
+                            unsigned int pte_index);
+void rmv_pdir_entry(unsigned int proc_index, unsigned int pde_index);
+void set_pdir_base(unsigned int index);
+void pdir_free(unsigned int proc_index);
+unsigned int free_all_ptbl(unsigned int proc_index);
+void swap_discard(unsigned int proc_index, unsigned int vaddr);
+void shm_release_proc(unsigned int proc_index);
+int elf_covers(int pid, unsigned int vaddr);
+void elf_unload(int pid);
 
 #endif  /* _KERN_ */
 
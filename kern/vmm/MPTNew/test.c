@@ -1,6 +1,12 @@
 #include <lib/debug.h>
+#include <lib/x86.h>
+#include <pmm/MATIntro/export.h>
+#include <pmm/MATCache/export.h>
 #include <pmm/MContainer/export.h>
+#include <vmm/MPTIntro/export.h>
 #include <vmm/MPTOp/export.h>
+#include <vmm/MPTKern/export.h>
+#include <vmm/MPTReclaim/export.h>
 #include <vmm/MPTNew/export.h>
 #include "export.h"
 
@@ -29,6 +35,205 @@ int MPTNew_test1()
     return 0;
 }
 
+int MPTNew_test2()
+{
+    unsigned int vaddr = 4096 * 1024 * 400;
+    unsigned int from = container_split(1, 20);
+    unsigned int to = container_split(1, 20);
+    unsigned int pte, page_index;
+
+    alloc_page(from, vaddr, PTE_P | PTE_W | PTE_U);
+    page_index = get_ptbl_entry_by_va(from, vaddr) / 4096;
+    *(unsigned int *) (page_index * 4096) = 422;
+
+    if (pdir_dup_cow(from, to) != 1) {
+        dprintf("test 2.1 failed: (%d != 1)\n", pdir_dup_cow(from, to));
+        return 1;
+    }
+    pte = get_ptbl_entry_by_va(to, vaddr);
+    if (pte / 4096 != page_index || (pte & PTE_W) || !(pte & PTE_COW)
+        || (get_ptbl_entry_by_va(from, vaddr) & PTE_W) || at_get_refcnt(page_index) != 2) {
+        dprintf("test 2.2 failed: (the page is not shared copy-on-write)\n");
+        return 1;
+    }
+    if (cow_fault(to, vaddr) != 1) {
+        dprintf("test 2.3 failed: (the copy-on-write fault is not resolved)\n");
+        return 1;
+    }
+    pte = get_ptbl_entry_by_va(to, vaddr);
+    if (pte / 4096 == page_index || !(pte & PTE_W)
+        || *(unsigned int *) (pte & 0xfffff000) != 422 || at_get_refcnt(page_index) != 1) {
+        dprintf("test 2.4 failed: (the page is not copied)\n");
+        return 1;
+    }
+    if (cow_fault(from, vaddr) != 1
+        || get_ptbl_entry_by_va(from, vaddr) != page_index * 4096 + (PTE_P | PTE_W | PTE_U)) {
+        dprintf("test 2.5 failed: (the last reference is not made writable)\n");
+        return 1;
+    }
+    if (cow_fault(from, vaddr) != 0) {
+        dprintf("test 2.6 failed: (a writable page is copied)\n");
+        return 1;
+    }
+    dprintf("test 2 passed.\n");
+    return 0;
+}
+
+int MPTNew_test3()
+{
+    unsigned int vaddr = 4096 * 1024 * 400;
+    unsigned int proc_index = container_split(1, 20);
+
+    if (fault_around(proc_index, vaddr + 100, 7) != 1) {
+        dprintf("test 3.1 failed: (a random fault maps more than one page)\n");
+        return 1;
+    }
+    if (fault_around(proc_index, vaddr + 4096, 7) != 2) {
+        dprintf("test 3.2 failed: (a sequential fault does not grow the window)\n");
+        return 1;
+    }
+    if (get_ptbl_entry_by_va(proc_index, vaddr + 2 * 4096) == 0
+        || get_ptbl_entry_by_va(proc_index, vaddr + 3 * 4096) != 0) {
+        dprintf("test 3.3 failed: (the window is not mapped)\n");
+        return 1;
+    }
+    if (fault_around(proc_index, vaddr + 100 * 4096, 7) != 1) {
+        dprintf("test 3.4 failed: (a random fault does not reset the window)\n");
+        return 1;
+    }
+    dprintf("test 3 passed.\n");
+    return 0;
+}
+
+int MPTNew_test4()
+{
+    unsigned int vaddr = 4096 * 1024 * 400;
+    unsigned int usage = container_get_usage(1);
+    unsigned int from = container_split(1, 20);
+    unsigned int to = container_split(1, 20);
+    unsigned int page_index;
+
+    alloc_page(from, vaddr, PTE_P | PTE_W | PTE_U);
+    alloc_page(from, vaddr + 4096, PTE_P | PTE_W | PTE_U);
+    page_index = get_ptbl_entry_by_va(from, vaddr) / 4096;
+    pdir_dup_cow(from, to);
+    // a page of the kernel image, which is not charged to the process
+    map_page(from, vaddr + 2 * 4096, 256, PTE_P | PTE_U);
+
+    if (pdir_destroy(0) != MagicNumber || pdir_destroy(1) != MagicNumber) {
+        dprintf("test 4.1 failed: (a process that cannot go is destroyed)\n");
+        return 1;
+    }
+    if (pdir_destroy(from) != 2 || container_is_used(from)
+        || container_get_usage(1) != usage + 20) {
+        dprintf("test 4.2 failed: (the address space is not torn down)\n");
+        return 1;
+    }
+    if (at_get_refcnt(page_index) != 1
+        || get_ptbl_entry_by_va(to, vaddr) / 4096 != page_index) {
+        dprintf("test 4.3 failed: (a page shared with another process is freed)\n");
+        return 1;
+    }
+    if (pdir_destroy(to) != 2 || at_is_allocated(page_index)
+        || container_get_usage(1) != usage) {
+        dprintf("test 4.4 failed: (the quota is not given back)\n");
+        return 1;
+    }
+    dprintf("test 4 passed.\n");
+    return 0;
+}
+
+// Takes every free page, chaining them through their first words.
+static unsigned int drain_pages(void)
+{
+    unsigned int head = 0, page_index;
+
+    while ((page_index = pcache_alloc()) != 0
+           || (page_index = pcache_alloc_zeroed()) != 0) {
+        *(unsigned int *) (page_index * 4096) = head;
+        head = page_index;
+    }
+    return head;
+}
+
+static void undrain_pages(unsigned int head)
+{
+    unsigned int next;
+
+    while (head != 0) {
+        next = *(unsigned int *) (head * 4096);
+        pcache_free(head);
+        head = next;
+    }
+}
+
+int MPTNew_test5()
+{
+    unsigned int vaddr = 4096 * 1024 * 400;
+    unsigned int proc_index = container_split(1, 20);
+    unsigned int nevicted, head, pde_page_index;
+
+    // a cold page to reclaim, in a page table that already exists
+    alloc_page(proc_index, vaddr, PTE_P | PTE_W | PTE_U);
+    nevicted = reclaim_get_nevicted();
+
+    head = drain_pages();
+    pde_page_index = alloc_page(proc_index, vaddr + 4096, PTE_P | PTE_W | PTE_U);
+    undrain_pages(head);
+
+    if (pde_page_index == MagicNumber
+        || (get_ptbl_entry_by_va(proc_index, vaddr + 4096) & PTE_P) == 0) {
+        dprintf("test 5.1 failed: (the allocation is not retried after reclaim)\n");
+        return 1;
+    }
+    if (reclaim_get_nevicted() == nevicted) {
+        dprintf("test 5.2 failed: (no page is evicted to make room)\n");
+        return 1;
+    }
+    dprintf("test 5 passed.\n");
+    return 0;
+}
+
+int MPTNew_test6()
+{
+    unsigned int vaddr = 4096 * 1024 * 400;
+    unsigned int proc_index = container_split(1, 20);
+    unsigned int other = container_split(1, 20);
+    unsigned int nloads, pte;
+
+    alloc_page(proc_index, vaddr, PTE_P | PTE_W | PTE_U);
+    alloc_page(other, vaddr, PTE_P | PTE_W | PTE_U);
+    *(unsigned int *) ((get_ptbl_entry_by_va(other, vaddr) & 0xfffff000) + 8) = 42;
+
+    // what the page fault handler does, in the page structure of the process
+    set_pdir_base(proc_index);
+    nloads = pdir_get_nloads();
+    alloc_page(proc_index, vaddr + 4096, PTE_P | PTE_W | PTE_U);
+    *(unsigned int *) (vaddr + 4096 + 8) = 7;
+    swap_out(other, vaddr);
+    swap_in(other, vaddr);
+    if (pdir_get_nloads() != nloads) {
+        set_pdir_base(0);
+        dprintf("test 6.1 failed: (CR3 is loaded)\n");
+        return 1;
+    }
+    set_pdir_base(0);
+
+    pte = get_ptbl_entry_by_va(proc_index, vaddr + 4096);
+    if (!(pte & PTE_P) || *(unsigned int *) ((pte & 0xfffff000) + 8) != 7
+        || *(unsigned int *) ((pte & 0xfffff000) + 12) != 0) {
+        dprintf("test 6.2 failed: (the page is not zeroed and mapped)\n");
+        return 1;
+    }
+    pte = get_ptbl_entry_by_va(other, vaddr);
+    if (!(pte & PTE_P) || *(unsigned int *) ((pte & 0xfffff000) + 8) != 42) {
+        dprintf("test 6.3 failed: (the page of another process is lost)\n");
+        return 1;
+    }
+    dprintf("test 6 passed.\n");
+    return 0;
+}
+
 /**
  * Write Your Own Test Script (optional)
  *
@@ -51,5 +256,6 @@ int MPTNew_test_own()
 
 int test_MPTNew()
 {
-    return MPTNew_test1() + MPTNew_test_own();
+    return MPTNew_test1() + MPTNew_test2() + MPTNew_test3() + MPTNew_test4()
+           + MPTNew_test5() + MPTNew_test6() + MPTNew_test_own();
 }
@@ -2,6 +2,14 @@
 
 #include "import.h"
 
+#define VM_USERLO     0x40000000
+#define VM_USERHI     0xF0000000
+#define VM_USERLO_PDE (VM_USERLO / (PAGESIZE * 1024))
+#define VM_USERHI_PDE (VM_USERHI / (PAGESIZE * 1024))
+
+#define PDE_INDEX(vaddr) ((vaddr) >> 22)
+#define PTE_INDEX(vaddr) (((vaddr) >> 12) & 0x3ff)
+
 /**
  * Returns the page table entry corresponding to the virtual address,
  * according to the page structure of process # [proc_index].
@@ -9,27 +17,49 @@
  */
 unsigned int get_ptbl_entry_by_va(unsigned int proc_index, unsigned int vaddr)
 {
-    // TODO
-    return 0;
+    if ((get_pdir_entry(proc_index, PDE_INDEX(vaddr)) & PTE_P) == 0) {
+        return 0;
+    }
+    return get_ptbl_entry(proc_index, PDE_INDEX(vaddr), PTE_INDEX(vaddr));
+}
+
+/**
+ * Reads the page table entries of the pages from [vaddr] on into [ptes]
+ * (see get_ptbl_entries): [n] of them, or fewer if the page table of [vaddr]
+ * ends before. Returns the number of entries read, at least 1 if [n] is not 0.
+ */
+unsigned int get_ptbl_entries_by_va(unsigned int proc_index, unsigned int vaddr,
+                                    unsigned int *ptes, unsigned int n)
+{
+    if (n > 1024 - PTE_INDEX(vaddr)) {
+        n = 1024 - PTE_INDEX(vaddr);
+    }
+    get_ptbl_entries(proc_index, PDE_INDEX(vaddr), PTE_INDEX(vaddr), ptes, n);
+    return n;
 }
 
 // Returns the page directory entry corresponding to the given virtual address.
 unsigned int get_pdir_entry_by_va(unsigned int proc_index, unsigned int vaddr)
 {
-    // TODO
-    return 0;
+    return get_pdir_entry(proc_index, PDE_INDEX(vaddr));
 }
 
 // Removes the page table entry for the given virtual address.
+// Nothing is done if there is no page table for the address.
 void rmv_ptbl_entry_by_va(unsigned int proc_index, unsigned int vaddr)
 {
-    // TODO
+    unsigned int pde = get_pdir_entry(proc_index, PDE_INDEX(vaddr));
+
+    if ((pde & PTE_P) == 0 || (pde & PTE_PS)) {
+        return;
+    }
+    rmv_ptbl_entry(proc_index, PDE_INDEX(vaddr), PTE_INDEX(vaddr));
 }
 
 // Removes the page directory entry for the given virtual address.
 void rmv_pdir_entry_by_va(unsigned int proc_index, unsigned int vaddr)
 {
-    // TODO
+    rmv_pdir_entry(proc_index, PDE_INDEX(vaddr));
 }
 
 // Maps the virtual address [vaddr] to the physical page # [page_index] with permission [perm].
@@ -37,14 +67,22 @@ void rmv_pdir_entry_by_va(unsigned int proc_index, unsigned int vaddr)
 void set_ptbl_entry_by_va(unsigned int proc_index, unsigned int vaddr,
                           unsigned int page_index, unsigned int perm)
 {
-    // TODO
+    set_ptbl_entry(proc_index, PDE_INDEX(vaddr), PTE_INDEX(vaddr), page_index, perm);
 }
 
 // Registers the mapping from [vaddr] to physical page # [page_index] in the page directory.
 void set_pdir_entry_by_va(unsigned int proc_index, unsigned int vaddr,
                           unsigned int page_index)
 {
-    // TODO
+    set_pdir_entry(proc_index, PDE_INDEX(vaddr), page_index);
+}
+
+// Maps the 4MB region containing [vaddr] to the 4MB physical region starting
+// at page # [page_index] with permission [perm], without a page table.
+void set_pdir_entry_large_by_va(unsigned int proc_index, unsigned int vaddr,
+                                unsigned int page_index, unsigned int perm)
+{
+    set_pdir_entry_large(proc_index, PDE_INDEX(vaddr), page_index, perm);
 }
 
 // Initializes the identity page table.
@@ -52,9 +90,18 @@ void set_pdir_entry_by_va(unsigned int proc_index, unsigned int vaddr,
 // While the permission for the rest should be PTE_P and PTE_W.
 void idptbl_init(unsigned int mbi_addr)
 {
-    // TODO: Define your local variables here.
+    unsigned int pde_index, pte_index, perm;
 
     container_init(mbi_addr);
 
-    // TODO
+    for (pde_index = 0; pde_index < 1024; pde_index++) {
+        if (pde_index < VM_USERLO_PDE || VM_USERHI_PDE <= pde_index) {
+            perm = PTE_P | PTE_W | PTE_G;
+        } else {
+            perm = PTE_P | PTE_W;
+        }
+        for (pte_index = 0; pte_index < 1024; pte_index++) {
+            set_ptbl_entry_identity(pde_index, pte_index, perm);
+        }
+    }
 }
@@ -6,8 +6,12 @@
 unsigned int get_pdir_entry_by_va(unsigned int proc_index, unsigned int vaddr);
 void set_pdir_entry_by_va(unsigned int proc_index, unsigned int vaddr,
                           unsigned int page_index);
+void set_pdir_entry_large_by_va(unsigned int proc_index, unsigned int vaddr,
+                                unsigned int page_index, unsigned int perm);
 void rmv_pdir_entry_by_va(unsigned int proc_index, unsigned int vaddr);
 unsigned int get_ptbl_entry_by_va(unsigned int proc_index, unsigned int vaddr);
+unsigned int get_ptbl_entries_by_va(unsigned int proc_index, unsigned int vaddr,
+                                    unsigned int *ptes, unsigned int n);
 void set_ptbl_entry_by_va(unsigned int proc_index, unsigned int vaddr,
                           unsigned int page_index, unsigned int perm);
 void rmv_ptbl_entry_by_va(unsigned int proc_index, unsigned int vaddr);
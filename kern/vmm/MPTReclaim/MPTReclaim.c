@@ -0,0 +1,360 @@
+#include <lib/debug.h>
+#include <lib/kmap.h>
+#include <lib/string.h>
+#include <lib/types.h>
+#include <lib/x86.h>
+
+#include "import.h"
+
+#define VM_USERLO     0x40000000
+#define VM_USERHI     0xF0000000
+#define VM_USERLO_PDE (VM_USERLO / (PAGESIZE * 1024))
+#define VM_USERHI_PDE (VM_USERHI / (PAGESIZE * 1024))
+
+/**
+ * Page reclaim.
+ *
+ * When physical memory runs out, cold anonymous user pages are compressed
+ * into an in-kernel store (backed by kmalloc) and their frames are freed.
+ * The page table entry of an evicted page is left not present, with
+ * PTE_ZSWAP set and the index of its store slot in place of the page index.
+ * The page is decompressed into a new frame on its next access (swap_in).
+ *
+ * Only pages that are worth it are evicted: normal pages (not frames of the
+ * kernel image) with a single reference, not copy-on-write, that compress to
+ * at most ZSTORE_MAX_LEN bytes.
+ */
+#define ZSTORE_NSLOTS  8192
+#define ZSTORE_MAX_LEN (PAGESIZE / 4)
+
+struct SZSlot {
+    void *data;             // the compressed page, NULL if the slot is free
+    unsigned short len;     // the length of the compressed page
+    unsigned short perm;    // the permission of the page table entry
+};
+
+static struct SZSlot ZSTORE[ZSTORE_NSLOTS];
+static unsigned int ZSTORE_HINT;     // where to start looking for a free slot
+static unsigned int ZSTORE_NPAGES;   // the number of pages in the store
+static unsigned int ZSTORE_NBYTES;   // their total compressed size
+static unsigned int RECLAIM_NEVICTED;
+static unsigned int RECLAIM_NRESTORED;
+
+// Room for a page that does not compress at all.
+static unsigned char ZSTORE_BUF[PAGESIZE + PAGESIZE / 128 + 1];
+
+/**
+ * The eviction candidates, rebuilt from the accessed bits of the page table
+ * entries by reclaim_scan. This is a single second-chance list rather than
+ * separate active and inactive lists: a page that was accessed since the
+ * previous scan only has its accessed bit cleared, so it becomes a candidate
+ * at the next scan unless it is used again in the meantime.
+ */
+#define LRU_SIZE 1024
+
+struct SLRUEntry {
+    unsigned int proc_index;
+    unsigned int vaddr;
+};
+
+static struct SLRUEntry LRU_LIST[LRU_SIZE];
+static unsigned int LRU_NPAGES;
+
+// The process reclaim_pages starts with, so that evictions go round robin.
+static unsigned int RECLAIM_HAND = 1;
+
+/**
+ * Compresses a page with a PackBits style encoding:
+ * a header byte h < 128 is followed by h + 1 literal bytes, and a header byte
+ * h >= 128 is followed by one byte repeated h - 125 times.
+ * Returns the compressed length, or 0 if it would exceed max.
+ */
+static unsigned int zcompress(const unsigned char *src, unsigned char *dst,
+                              unsigned int max)
+{
+    unsigned int i, j, run, out;
+
+    i = 0;
+    out = 0;
+    while (i < PAGESIZE) {
+        run = 1;
+        while (i + run < PAGESIZE && run < 130 && src[i + run] == src[i]) {
+            run++;
+        }
+        if (run >= 3) {
+            if (out + 2 > max) {
+                return 0;
+            }
+            dst[out++] = 125 + run;
+            dst[out++] = src[i];
+            i += run;
+            continue;
+        }
+
+        // gather literals up to the next run of 3 equal bytes
+        j = i;
+        while (j < PAGESIZE && j - i < 128) {
+            if (j + 2 < PAGESIZE && src[j] == src[j + 1] && src[j] == src[j + 2]) {
+                break;
+            }
+            j++;
+        }
+        if (out + 1 + (j - i) > max) {
+            return 0;
+        }
+        dst[out++] = j - i - 1;
+        memcpy(&dst[out], &src[i], j - i);
+        out += j - i;
+        i = j;
+    }
+
+    return out;
+}
+
+static void zdecompress(const unsigned char *src, unsigned char *dst)
+{
+    unsigned int i, out, n;
+
+    i = 0;
+    out = 0;
+    while (out < PAGESIZE) {
+        if (src[i] < 128) {
+            n = src[i] + 1;
+            memcpy(&dst[out], &src[i + 1], n);
+            i += 1 + n;
+        } else {
+            n = src[i] - 125;
+            memset(&dst[out], src[i + 1], n);
+            i += 2;
+        }
+        out += n;
+    }
+}
+
+static unsigned int zstore_alloc_slot(void)
+{
+    unsigned int i, slot;
+
+    for (i = 0; i < ZSTORE_NSLOTS; i++) {
+        slot = (ZSTORE_HINT + i) % ZSTORE_NSLOTS;
+        if (ZSTORE[slot].data == NULL) {
+            ZSTORE_HINT = slot + 1;
+            return slot;
+        }
+    }
+    return ZSTORE_NSLOTS;
+}
+
+static void zstore_free_slot(unsigned int slot)
+{
+    kfree(ZSTORE[slot].data);
+    ZSTORE_NPAGES--;
+    ZSTORE_NBYTES -= ZSTORE[slot].len;
+    ZSTORE[slot].data = NULL;
+}
+
+// Whether the page table entry maps a page that may be evicted.
+static unsigned int reclaim_evictable(unsigned int pte)
+{
+    unsigned int page_index = pte / PAGESIZE;
+
+    return (pte & PTE_P) && (pte & PTE_U) && !(pte & PTE_COW)
+           && at_is_norm(page_index) && at_get_refcnt(page_index) == 1;
+}
+
+/**
+ * Compresses the page at [vaddr] of process # [proc_index] into the store
+ * and frees its frame.
+ * Returns 1 if the page is evicted, or 0 if it cannot be (not evictable,
+ * does not compress well enough, or the store or the kernel pages are
+ * full).
+ */
+unsigned int swap_out(unsigned int proc_index, unsigned int vaddr)
+{
+    unsigned int pte, page_index, len, slot;
+    void *data;
+
+    pte = get_ptbl_entry_by_va(proc_index, vaddr);
+    if (!reclaim_evictable(pte)) {
+        return 0;
+    }
+    page_index = pte / PAGESIZE;
+
+    len = zcompress(kmap(KMAP_SRC, page_index), ZSTORE_BUF, ZSTORE_MAX_LEN);
+    if (len == 0) {
+        return 0;
+    }
+
+    slot = zstore_alloc_slot();
+    if (slot == ZSTORE_NSLOTS) {
+        return 0;
+    }
+    data = kmalloc(len);
+    if (data == NULL) {
+        return 0;
+    }
+    memcpy(data, ZSTORE_BUF, len);
+
+    ZSTORE[slot].data = data;
+    ZSTORE[slot].len = len;
+    ZSTORE[slot].perm = pte & (PTE_P | PTE_W | PTE_U);
+    ZSTORE_NPAGES++;
+    ZSTORE_NBYTES += len;
+
+    set_ptbl_entry_by_va(proc_index, vaddr, slot, PTE_ZSWAP);
+    tlb_invalidate(proc_index, vaddr, 1);
+    container_free(proc_index, page_index);
+    RECLAIM_NEVICTED++;
+
+    return 1;
+}
+
+/**
+ * Rebuilds the candidate list from the evictable pages of process
+ * # [proc_index] whose accessed bits are clear, and clears the bits it finds
+ * set. The list is bounded by LRU_SIZE; pages beyond that are left for a later
+ * scan. Returns the number of candidates found.
+ */
+unsigned int reclaim_scan(unsigned int proc_index)
+{
+    unsigned int pde_index, vaddr, va, pde, pte;
+
+    LRU_NPAGES = 0;
+
+    for (pde_index = VM_USERLO_PDE; pde_index < VM_USERHI_PDE; pde_index++) {
+        vaddr = pde_index * PAGESIZE * 1024;
+        pde = get_pdir_entry_by_va(proc_index, vaddr);
+        if ((pde & PTE_P) == 0 || (pde & PTE_PS)) {
+            continue;
+        }
+        for (va = vaddr; va < vaddr + PAGESIZE * 1024; va += PAGESIZE) {
+            pte = get_ptbl_entry_by_va(proc_index, va);
+            if (!reclaim_evictable(pte)) {
+                continue;
+            }
+            if (pte & PTE_A) {
+                set_ptbl_entry_by_va(proc_index, va, pte / PAGESIZE,
+                                     pte & 0xfff & ~PTE_A);
+                // or the CPU would keep using the entry without setting it again
+                tlb_invalidate(proc_index, va, 1);
+            } else if (LRU_NPAGES < LRU_SIZE) {
+                LRU_LIST[LRU_NPAGES].proc_index = proc_index;
+                LRU_LIST[LRU_NPAGES].vaddr = va;
+                LRU_NPAGES++;
+            }
+        }
+    }
+
+    return LRU_NPAGES;
+}
+
+/**
+ * Tries to free [n] frames by evicting the candidates of reclaim_scan,
+ * visiting the user processes round robin. Recently used pages get a second
+ * chance: their accessed bits are cleared by the first pass, and they are only
+ * evicted by the second pass if they have not been used since.
+ * Returns the number of frames freed.
+ */
+unsigned int reclaim_pages(unsigned int n)
+{
+    unsigned int pass, i, proc_index, nfreed;
+
+    nfreed = 0;
+    for (pass = 0; pass < 2 && nfreed < n; pass++) {
+        for (i = 1; i < NUM_IDS && nfreed < n; i++) {
+            // process 0 maps the user range to the kernel identity map
+            proc_index = (RECLAIM_HAND + i - 2) % (NUM_IDS - 1) + 1;
+            reclaim_scan(proc_index);
+            while (LRU_NPAGES > 0 && nfreed < n) {
+                LRU_NPAGES--;
+                nfreed += swap_out(LRU_LIST[LRU_NPAGES].proc_index,
+                                   LRU_LIST[LRU_NPAGES].vaddr);
+            }
+            if (nfreed >= n) {
+                RECLAIM_HAND = proc_index % (NUM_IDS - 1) + 1;
+            }
+        }
+    }
+
+#ifdef DEBUG_MSG
+    if (nfreed > 0) {
+        KERN_DEBUG("reclaim: %d pages evicted, %d pages in %d bytes stored.\n",
+                   nfreed, ZSTORE_NPAGES, ZSTORE_NBYTES);
+    }
+#endif
+
+    return nfreed;
+}
+
+/**
+ * Brings the evicted page at [vaddr] of process # [proc_index] back into a
+ * new frame (charged to the process), and releases its store slot.
+ * Returns 1 if the page is restored, 0 if it was not evicted,
+ * and MagicNumber if there is no frame to restore it to.
+ */
+unsigned int swap_in(unsigned int proc_index, unsigned int vaddr)
+{
+    unsigned int pte, slot, page_index;
+
+    pte = get_ptbl_entry_by_va(proc_index, vaddr);
+    if ((pte & PTE_P) || !(pte & PTE_ZSWAP)) {
+        return 0;
+    }
+    slot = pte / PAGESIZE;
+
+    page_index = container_alloc(proc_index);
+    if (page_index == 0 && reclaim_pages(1) > 0) {
+        page_index = container_alloc(proc_index);
+    }
+    if (page_index == 0) {
+        return MagicNumber;
+    }
+
+    zdecompress(ZSTORE[slot].data, kmap(KMAP_DST, page_index));
+    set_ptbl_entry_by_va(proc_index, vaddr, page_index,
+                         ZSTORE[slot].perm | PTE_A);
+    zstore_free_slot(slot);
+    RECLAIM_NRESTORED++;
+
+    return 1;
+}
+
+/**
+ * Drops the evicted page at [vaddr] of process # [proc_index] without
+ * restoring it, e.g., when the mapping is torn down.
+ */
+void swap_discard(unsigned int proc_index, unsigned int vaddr)
+{
+    unsigned int pte;
+
+    pte = get_ptbl_entry_by_va(proc_index, vaddr);
+    if ((pte & PTE_P) || !(pte & PTE_ZSWAP)) {
+        return;
+    }
+    zstore_free_slot(pte / PAGESIZE);
+    unmap_page(proc_index, vaddr);
+}
+
+// The number of pages in the compressed store.
+unsigned int reclaim_get_nstored(void)
+{
+    return ZSTORE_NPAGES;
+}
+
+// The total size of the pages in the compressed store, in bytes.
+unsigned int reclaim_get_nbytes(void)
+{
+    return ZSTORE_NBYTES;
+}
+
+// The number of pages evicted so far.
+unsigned int reclaim_get_nevicted(void)
+{
+    return RECLAIM_NEVICTED;
+}
+
+// The number of evicted pages restored so far.
+unsigned int reclaim_get_nrestored(void)
+{
+    return RECLAIM_NRESTORED;
+}
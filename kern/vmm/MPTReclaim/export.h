@@ -0,0 +1,18 @@
+#ifndef _KERN_VMM_MPTRECLAIM_H_
+#define _KERN_VMM_MPTRECLAIM_H_
+
+#ifdef _KERN_
+
+unsigned int reclaim_scan(unsigned int proc_index);
+unsigned int reclaim_pages(unsigned int n);
+unsigned int swap_out(unsigned int proc_index, unsigned int vaddr);
+unsigned int swap_in(unsigned int proc_index, unsigned int vaddr);
+void swap_discard(unsigned int proc_index, unsigned int vaddr);
+unsigned int reclaim_get_nstored(void);
+unsigned int reclaim_get_nbytes(void);
+unsigned int reclaim_get_nevicted(void);
+unsigned int reclaim_get_nrestored(void);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_VMM_MPTRECLAIM_H_ */
@@ -0,0 +1,22 @@
+#ifndef _KERN_VMM_MPTRECLAIM_H_
+#define _KERN_VMM_MPTRECLAIM_H_
+
+#ifdef _KERN_
+
+unsigned int at_is_norm(unsigned int page_index);
+unsigned int at_get_refcnt(unsigned int page_index);
+void *kmalloc(unsigned int size);
+void kfree(void *ptr);
+unsigned int container_alloc(unsigned int id);
+void container_free(unsigned int id, unsigned int page_index);
+unsigned int get_pdir_entry_by_va(unsigned int proc_index, unsigned int vaddr);
+unsigned int get_ptbl_entry_by_va(unsigned int proc_index, unsigned int vaddr);
+void set_ptbl_entry_by_va(unsigned int proc_index, unsigned int vaddr,
+                          unsigned int page_index, unsigned int perm);
+unsigned int unmap_page(unsigned int proc_index, unsigned int vaddr);
+void tlb_invalidate(unsigned int proc_index, unsigned int vaddr,
+                    unsigned int npages);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_VMM_MPTRECLAIM_H_ */
@@ -0,0 +1,60 @@
+#include <lib/debug.h>
+#include <lib/x86.h>
+#include <pmm/MContainer/export.h>
+#include <vmm/MPTOp/export.h>
+#include <vmm/MPTKern/export.h>
+#include "export.h"
+
+int MPTReclaim_test1()
+{
+    unsigned int vaddr = 4096 * 1024 * 400;
+    unsigned int proc_index = container_split(1, 20);
+    unsigned int page_index = container_alloc_zeroed(proc_index);
+    unsigned int nstored = reclaim_get_nstored();
+    unsigned int pte;
+
+    *(unsigned int *) (page_index * 4096 + 8) = 422;
+    map_page(proc_index, vaddr, page_index, PTE_P | PTE_W | PTE_U);
+
+    if (reclaim_scan(proc_index) != 1) {
+        dprintf("test 1.1 failed: (the cold page is not a candidate)\n");
+        return 1;
+    }
+    set_ptbl_entry_by_va(proc_index, vaddr, page_index, PTE_P | PTE_W | PTE_U | PTE_A);
+    if (reclaim_scan(proc_index) != 0
+        || (get_ptbl_entry_by_va(proc_index, vaddr) & PTE_A)) {
+        dprintf("test 1.2 failed: (the accessed page is not given a second chance)\n");
+        return 1;
+    }
+    if (swap_out(proc_index, vaddr) != 1) {
+        dprintf("test 1.3 failed: (the page is not evicted)\n");
+        return 1;
+    }
+    pte = get_ptbl_entry_by_va(proc_index, vaddr);
+    if ((pte & PTE_P) || !(pte & PTE_ZSWAP) || reclaim_get_nstored() != nstored + 1) {
+        dprintf("test 1.4 failed: (the page is not in the compressed store)\n");
+        return 1;
+    }
+    if (swap_in(proc_index, vaddr) != 1) {
+        dprintf("test 1.5 failed: (the page is not restored)\n");
+        return 1;
+    }
+    pte = get_ptbl_entry_by_va(proc_index, vaddr);
+    if (!(pte & PTE_P) || !(pte & PTE_W) || *(unsigned int *) ((pte & 0xfffff000) + 8) != 422
+        || *(unsigned int *) ((pte & 0xfffff000) + 12) != 0
+        || reclaim_get_nstored() != nstored) {
+        dprintf("test 1.6 failed: (the restored page differs)\n");
+        return 1;
+    }
+    if (swap_in(proc_index, vaddr) != 0) {
+        dprintf("test 1.7 failed: (a present page is restored)\n");
+        return 1;
+    }
+    dprintf("test 1 passed.\n");
+    return 0;
+}
+
+int test_MPTReclaim()
+{
+    return MPTReclaim_test1();
+}
@@ -0,0 +1,260 @@
+#include <lib/debug.h>
+#include <lib/types.h>
+#include <lib/x86.h>
+
+#include "import.h"
+
+#define VM_USERLO 0x40000000
+#define VM_USERHI 0xF0000000
+
+/**
+ * Shared memory segments.
+ *
+ * A segment is a set of zeroed physical pages, created once by a container
+ * that is charged for all of them, and mapped at a contiguous range of
+ * addresses into any number of address spaces, each with its own permission.
+ * The page table entries of a segment are marked with PTE_SHM.
+ *
+ * The segment holds one reference to each of its pages, and each address
+ * space it is mapped into holds one more, so that the pages are never evicted
+ * (see swap_out) and survive as long as any of them.
+ * A segment is removed with shm_destroy, but its pages are only freed, and
+ * the charge to the creator only dropped, when the last mapping goes away.
+ * A segment has at most SHM_MAX_PAGES pages, so that its page array fits in
+ * the largest kmalloc object.
+ */
+
+struct SShmSeg {
+    unsigned int used;             // whether the segment exists
+    unsigned int removed;          // whether it goes away with its last mapping
+    unsigned int owner;            // the creating container, charged for the pages
+    unsigned int npages;           // the number of pages
+    unsigned int nattached;        // the number of address spaces it is mapped into
+    unsigned int *pages;           // the page indices (kmalloc'd)
+    unsigned int vaddr[NUM_IDS];   // where each process maps it, 0 if it does not
+};
+
+static struct SShmSeg SHM_SEGS[SHM_NSEGS];
+
+static unsigned int shm_is_valid(unsigned int shmid)
+{
+    return shmid < SHM_NSEGS && SHM_SEGS[shmid].used;
+}
+
+// Frees the pages of the segment and drops the charge to its owner.
+static void shm_release(unsigned int shmid)
+{
+    struct SShmSeg *seg = &SHM_SEGS[shmid];
+    unsigned int i;
+
+    for (i = 0; i < seg->npages; i++) {
+        container_free(seg->owner, seg->pages[i]);
+    }
+    kfree(seg->pages);
+    seg->pages = NULL;
+    seg->used = 0;
+}
+
+/**
+ * Creates a segment of [npages] zeroed pages, charged to container # [id],
+ * given that this does not exceed its quota.
+ * Returns the id of the segment, or SHM_NSEGS in the case of error.
+ */
+unsigned int shm_create(unsigned int id, unsigned int npages)
+{
+    struct SShmSeg *seg;
+    unsigned int shmid, i, page_index;
+
+    if (npages == 0 || npages > SHM_MAX_PAGES || !container_can_consume(id, npages)) {
+        return SHM_NSEGS;
+    }
+
+    for (shmid = 0; shmid < SHM_NSEGS; shmid++) {
+        if (!SHM_SEGS[shmid].used) {
+            break;
+        }
+    }
+    if (shmid == SHM_NSEGS) {
+        return SHM_NSEGS;
+    }
+    seg = &SHM_SEGS[shmid];
+
+    seg->pages = kmalloc(npages * sizeof(unsigned int));
+    if (seg->pages == NULL) {
+        return SHM_NSEGS;
+    }
+    for (i = 0; i < npages; i++) {
+        page_index = container_alloc_zeroed(id);
+        if (page_index == 0) {
+            while (i > 0) {
+                i--;
+                container_free(id, seg->pages[i]);
+            }
+            kfree(seg->pages);
+            seg->pages = NULL;
+            return SHM_NSEGS;
+        }
+        seg->pages[i] = page_index;
+    }
+
+    seg->used = 1;
+    seg->removed = 0;
+    seg->owner = id;
+    seg->npages = npages;
+    seg->nattached = 0;
+    for (i = 0; i < NUM_IDS; i++) {
+        seg->vaddr[i] = 0;
+    }
+
+    return shmid;
+}
+
+/**
+ * Maps the segment # [shmid] into the address space of process # [proc_index]
+ * at [vaddr], with the given permission. The page tables are charged to the
+ * process, but the pages of the segment are not.
+ * [vaddr] must be page aligned, and the whole range must lie in the user
+ * portion and be unmapped. A process maps a segment at most once, and a
+ * removed segment cannot be mapped anymore.
+ * Returns the number of pages mapped, or MagicNumber in the case of error.
+ */
+unsigned int shm_attach(unsigned int shmid, unsigned int proc_index,
+                        unsigned int vaddr, unsigned int perm)
+{
+    struct SShmSeg *seg;
+    unsigned int i;
+
+    if (!shm_is_valid(shmid) || proc_index >= NUM_IDS) {
+        return MagicNumber;
+    }
+    seg = &SHM_SEGS[shmid];
+    if (seg->removed || seg->vaddr[proc_index] != 0 || vaddr % PAGESIZE != 0
+        || vaddr < VM_USERLO || vaddr > VM_USERHI - seg->npages * PAGESIZE) {
+        return MagicNumber;
+    }
+
+    for (i = 0; i < seg->npages; i++) {
+        if ((get_pdir_entry_by_va(proc_index, vaddr + i * PAGESIZE) & PTE_PS)
+            || get_ptbl_entry_by_va(proc_index, vaddr + i * PAGESIZE) != 0) {
+            return MagicNumber;
+        }
+    }
+
+    for (i = 0; i < seg->npages; i++) {
+        if (map_page(proc_index, vaddr + i * PAGESIZE, seg->pages[i],
+                     perm | PTE_SHM) == MagicNumber) {
+            unmap_range(proc_index, vaddr, i);
+            while (i > 0) {
+                i--;
+                at_dec_refcnt(seg->pages[i]);
+            }
+            return MagicNumber;
+        }
+        at_inc_refcnt(seg->pages[i]);
+    }
+
+    seg->vaddr[proc_index] = vaddr;
+    seg->nattached++;
+    return seg->npages;
+}
+
+/**
+ * Removes the mapping of the segment # [shmid] from the address space of
+ * process # [proc_index]. The segment is released if it was removed and this
+ * was its last mapping.
+ * Returns 1 on success, and 0 if the process does not map the segment.
+ */
+unsigned int shm_detach(unsigned int shmid, unsigned int proc_index)
+{
+    struct SShmSeg *seg;
+    unsigned int i;
+
+    if (!shm_is_valid(shmid) || proc_index >= NUM_IDS
+        || SHM_SEGS[shmid].vaddr[proc_index] == 0) {
+        return 0;
+    }
+    seg = &SHM_SEGS[shmid];
+
+    unmap_range(proc_index, seg->vaddr[proc_index], seg->npages);
+    for (i = 0; i < seg->npages; i++) {
+        at_dec_refcnt(seg->pages[i]);
+    }
+    seg->vaddr[proc_index] = 0;
+    seg->nattached--;
+
+    if (seg->removed && seg->nattached == 0) {
+        shm_release(shmid);
+    }
+    return 1;
+}
+
+/**
+ * Removes the segment # [shmid]: it cannot be mapped anymore, and it is
+ * released as soon as it is not mapped anywhere, which may be right away.
+ * Returns 1 on success, and 0 if there is no such segment.
+ */
+unsigned int shm_destroy(unsigned int shmid)
+{
+    if (!shm_is_valid(shmid) || SHM_SEGS[shmid].removed) {
+        return 0;
+    }
+    SHM_SEGS[shmid].removed = 1;
+    if (SHM_SEGS[shmid].nattached == 0) {
+        shm_release(shmid);
+    }
+    return 1;
+}
+
+/**
+ * Detaches all the segments mapped by process # [proc_index], and removes the
+ * ones it created, e.g., before its address space is torn down.
+ * The pages of a removed segment that is still mapped by other processes stay
+ * charged, to the parent of the process from now on, so that the container of
+ * the process can be destroyed.
+ */
+void shm_release_proc(unsigned int proc_index)
+{
+    struct SShmSeg *seg;
+    unsigned int shmid, parent, i;
+
+    for (shmid = 0; shmid < SHM_NSEGS; shmid++) {
+        seg = &SHM_SEGS[shmid];
+        if (!seg->used) {
+            continue;
+        }
+        shm_detach(shmid, proc_index);
+        if (!seg->used || seg->owner != proc_index) {
+            continue;
+        }
+        if (seg->nattached != 0) {
+            parent = container_get_parent(proc_index);
+            for (i = 0; i < seg->npages; i++) {
+                container_share(parent, seg->pages[i]);
+                container_free(proc_index, seg->pages[i]);
+            }
+            seg->owner = parent;
+        }
+        shm_destroy(shmid);
+    }
+}
+
+// The number of pages of the segment # [shmid], or 0 if there is no such segment.
+unsigned int shm_get_npages(unsigned int shmid)
+{
+    return shm_is_valid(shmid) ? SHM_SEGS[shmid].npages : 0;
+}
+
+// The number of address spaces the segment # [shmid] is mapped into.
+unsigned int shm_get_nattached(unsigned int shmid)
+{
+    return shm_is_valid(shmid) ? SHM_SEGS[shmid].nattached : 0;
+}
+
+// Where process # [proc_index] maps the segment # [shmid], or 0 if it does not.
+unsigned int shm_get_vaddr(unsigned int shmid, unsigned int proc_index)
+{
+    if (!shm_is_valid(shmid) || proc_index >= NUM_IDS) {
+        return 0;
+    }
+    return SHM_SEGS[shmid].vaddr[proc_index];
+}
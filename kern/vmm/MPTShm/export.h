@@ -0,0 +1,18 @@
+#ifndef _KERN_VMM_MPTSHM_H_
+#define _KERN_VMM_MPTSHM_H_
+
+#ifdef _KERN_
+
+unsigned int shm_create(unsigned int id, unsigned int npages);
+unsigned int shm_attach(unsigned int shmid, unsigned int proc_index,
+                        unsigned int vaddr, unsigned int perm);
+unsigned int shm_detach(unsigned int shmid, unsigned int proc_index);
+unsigned int shm_destroy(unsigned int shmid);
+void shm_release_proc(unsigned int proc_index);
+unsigned int shm_get_npages(unsigned int shmid);
+unsigned int shm_get_nattached(unsigned int shmid);
+unsigned int shm_get_vaddr(unsigned int shmid, unsigned int proc_index);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_VMM_MPTSHM_H_ */
@@ -0,0 +1,24 @@
+#ifndef _KERN_VMM_MPTSHM_H_
+#define _KERN_VMM_MPTSHM_H_
+
+#ifdef _KERN_
+
+void at_inc_refcnt(unsigned int page_index);
+unsigned int at_dec_refcnt(unsigned int page_index);
+void *kmalloc(unsigned int size);
+void kfree(void *ptr);
+unsigned int container_get_parent(unsigned int id);
+unsigned int container_can_consume(unsigned int id, unsigned int n);
+unsigned int container_alloc_zeroed(unsigned int id);
+void container_free(unsigned int id, unsigned int page_index);
+void container_share(unsigned int id, unsigned int page_index);
+unsigned int get_pdir_entry_by_va(unsigned int proc_index, unsigned int vaddr);
+unsigned int get_ptbl_entry_by_va(unsigned int proc_index, unsigned int vaddr);
+unsigned int map_page(unsigned int proc_index, unsigned int vaddr,
+                      unsigned int page_index, unsigned int perm);
+unsigned int unmap_range(unsigned int proc_index, unsigned int vaddr,
+                         unsigned int npages);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_VMM_MPTSHM_H_ */
@@ -0,0 +1,113 @@
+#include <lib/debug.h>
+#include <lib/x86.h>
+#include <pmm/MATIntro/export.h>
+#include <pmm/MContainer/export.h>
+#include <vmm/MPTOp/export.h>
+#include "export.h"
+
+int MPTShm_test1()
+{
+    unsigned int vaddr = 4096 * 1024 * 410;
+    unsigned int producer = container_split(1, 20);
+    unsigned int consumer = container_split(1, 20);
+    unsigned int shmid = shm_create(producer, 2);
+    unsigned int pte, pte2;
+
+    if (shmid == SHM_NSEGS || container_get_usage(producer) != 2) {
+        dprintf("test 1.1 failed: (the segment is not charged to its creator)\n");
+        return 1;
+    }
+    if (shm_attach(shmid, producer, vaddr, PTE_P | PTE_W | PTE_U) != 2
+        || shm_attach(shmid, consumer, vaddr + 8 * 4096, PTE_P | PTE_U) != 2) {
+        dprintf("test 1.2 failed: (the segment is not mapped)\n");
+        return 1;
+    }
+    if (shm_attach(shmid, consumer, vaddr, PTE_P | PTE_U) != MagicNumber) {
+        dprintf("test 1.3 failed: (the segment is mapped twice)\n");
+        return 1;
+    }
+    pte = get_ptbl_entry_by_va(producer, vaddr + 4096);
+    *(unsigned int *) ((pte & 0xfffff000) + 4) = 422;
+    pte2 = get_ptbl_entry_by_va(consumer, vaddr + 9 * 4096);
+    if ((pte2 & 0xfffff000) != (pte & 0xfffff000) || (pte2 & PTE_W) || !(pte2 & PTE_SHM)
+        || *(unsigned int *) ((pte2 & 0xfffff000) + 4) != 422
+        || at_get_refcnt(pte / 4096) != 3 || container_get_usage(consumer) != 2) {
+        dprintf("test 1.4 failed: (the pages are not shared)\n");
+        return 1;
+    }
+    if (shm_destroy(shmid) != 1 || shm_get_npages(shmid) != 2
+        || shm_attach(shmid, 1, vaddr, PTE_P | PTE_U) != MagicNumber) {
+        dprintf("test 1.5 failed: (a mapped segment is released)\n");
+        return 1;
+    }
+    if (shm_detach(shmid, producer) != 1 || get_ptbl_entry_by_va(producer, vaddr) != 0
+        || shm_get_nattached(shmid) != 1 || shm_detach(shmid, producer) != 0) {
+        dprintf("test 1.6 failed: (the segment is not detached)\n");
+        return 1;
+    }
+    if (shm_detach(shmid, consumer) != 1 || shm_get_npages(shmid) != 0
+        || at_get_refcnt(pte / 4096) != 0 || container_get_usage(producer) != 1) {
+        dprintf("test 1.7 failed: (the segment is not released with its last mapping)\n");
+        return 1;
+    }
+    dprintf("test 1 passed.\n");
+    return 0;
+}
+
+int MPTShm_test2()
+{
+    unsigned int vaddr = 4096 * 1024 * 410;
+    unsigned int usage = container_get_usage(1);
+    unsigned int producer = container_split(1, 20);
+    unsigned int consumer = container_split(1, 20);
+    unsigned int shmid = shm_create(producer, 4);
+
+    shm_attach(shmid, consumer, vaddr, PTE_P | PTE_W | PTE_U);
+    shm_release_proc(producer);
+    if (shm_get_nattached(shmid) != 1 || container_get_usage(producer) != 0
+        || container_get_usage(1) != usage + 40 + 4) {
+        dprintf("test 2.1 failed: (the segment is not handed to the parent)\n");
+        return 1;
+    }
+    if (container_destroy(producer) != 1) {
+        dprintf("test 2.2 failed: (the creator cannot be destroyed)\n");
+        return 1;
+    }
+    if (shm_detach(shmid, consumer) != 1 || shm_get_npages(shmid) != 0
+        || container_get_usage(1) != usage + 20) {
+        dprintf("test 2.3 failed: (the segment is not released)\n");
+        return 1;
+    }
+    dprintf("test 2 passed.\n");
+    return 0;
+}
+
+int MPTShm_test3()
+{
+    unsigned int usage = container_get_usage(0);
+    unsigned int id = container_split(0, SHM_MAX_PAGES + 1);
+    unsigned int shmid;
+
+    if (shm_create(id, SHM_MAX_PAGES + 1) != SHM_NSEGS || container_get_usage(id) != 0) {
+        dprintf("test 3.1 failed: (a segment larger than SHM_MAX_PAGES is created)\n");
+        return 1;
+    }
+    shmid = shm_create(id, SHM_MAX_PAGES);
+    if (shmid == SHM_NSEGS || shm_get_npages(shmid) != SHM_MAX_PAGES
+        || container_get_usage(id) != SHM_MAX_PAGES) {
+        dprintf("test 3.2 failed: (a segment of SHM_MAX_PAGES pages is not created)\n");
+        return 1;
+    }
+    if (shm_destroy(shmid) != 1 || container_get_usage(id) != 0
+        || container_destroy(id) != 1 || container_get_usage(0) != usage) {
+        dprintf("test 3.3 failed: (the segment is not released)\n");
+        return 1;
+    }
+    dprintf("test 3 passed.\n");
+    return 0;
+}
+
+int test_MPTShm()
+{
+    return MPTShm_test1() + MPTShm_test2() + MPTShm_test3();
+}
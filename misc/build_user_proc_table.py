@@ -4,9 +4,35 @@ import sys
 
 sys.argv.pop(0)
 
+asm = len(sys.argv) > 0 and sys.argv[0] == "--asm"
+if asm:
+	sys.argv.pop(0)
+
 names = [ f.rsplit("/", 1)[-1] for f in sys.argv]
 
-elfs = ["_binary_{}_start".format(f.replace("/", "_").replace(".", "_")) for f in sys.argv]
+bins = ["_binary_{}".format(f.replace("/", "_").replace(".", "_")) for f in sys.argv]
+
+# With --asm, the binaries are embedded with .incbin instead of ld -b binary,
+# which gives them no alignment: each one starts on a page boundary, so that
+# the kernel can map the pages of a program to user space in place.
+if asm:
+	print("/*")
+	print(" * WARNING: this file is auto-generated by misc/build_user_proc_table.py")
+	print(" *          changes to this file will be overwritten")
+	print(" */")
+	print()
+	print("\t.data")
+	for f, b in zip(sys.argv, bins):
+		print("\t.balign 4096")
+		print("\t.globl {0}_start, {0}_end, {0}_size".format(b))
+		print("{}_start:".format(b))
+		print("\t.incbin \"{}\"".format(f))
+		print("{}_end:".format(b))
+		print("\t.set {0}_size, {0}_end - {0}_start".format(b))
+	print("\t.balign 4096")
+	sys.exit(0)
+
+elfs = ["{}_start".format(b) for b in bins]
 
 last_elf = len(elfs) - 1
 